@@ -0,0 +1,35 @@
+#ifndef ALIGNEDBUFFER_H
+#define ALIGNEDBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-size array of T whose first element is aligned on `alignment` bytes, for SIMD loads.
+// Elements are left uninitialised.
+template <typename T>
+class AlignedBuffer {
+public:
+    static constexpr size_t alignment = 64;
+
+    void resize(size_t n) {
+        if (n == m_size) {
+            return;
+        }
+        m_block.reset(new unsigned char[n * sizeof(T) + alignment]);
+        uintptr_t base = reinterpret_cast<uintptr_t>(m_block.get());
+        m_data = reinterpret_cast<T*>(m_block.get() + (alignment - base % alignment) % alignment);
+        m_size = n;
+    }
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    std::unique_ptr<unsigned char[]> m_block;
+    T* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif // ALIGNEDBUFFER_H
@@ -0,0 +1,199 @@
+#include "batch.h"
+#include "mappedFile.h"
+#include "qoiCodec.h"
+#include "rawImage.h"
+#include "scheduler.h"
+#include "seamCarving.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "../libs/stb_image.h"
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Busy time of one stage, updated by concurrent tasks
+struct StageCounter {
+    atomic<long long> nanoseconds{0};
+    atomic<int> runs{0};
+
+    void add(Clock::time_point start) {
+        nanoseconds += chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+        ++runs;
+    }
+
+    BatchStageStats stats() const {
+        BatchStageStats s;
+        s.busySeconds = nanoseconds * 1e-9;
+        s.runs = runs;
+        return s;
+    }
+};
+
+// Rough peak memory of carving an image: the working copy of the decoder, the pixels, the energy,
+// the 1-byte dp back-pointers and one packed RGBA copy per output waiting to be encoded. Out of
+// core only the decoder copy and the outputs stay in memory.
+static size_t estimateImageBytes(int width, int height, const Settings& settings, size_t outputs) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    size_t cost_size = settings.costType == CostType::Double ? sizeof(double) : sizeof(float);
+    size_t per_pixel = 4;
+    if (!settings.outOfCore) {
+        size_t planes = settings.usesLuminancePlane() ? (settings.alphaInEnergy ? 2 : 1) : settings.planarLayout ? 4 : 0;
+        per_pixel += sizeof(Pixel) + cost_size + sizeof(int8_t) + planes;
+    }
+    return pixels * (per_pixel + 4 * outputs);
+}
+
+// Size of an input image without decoding it
+static bool imageSize(const string& input, int& width, int& height) {
+    if (readQoiSize(input, width, height)) {
+        return true;
+    }
+    MappedFile file;
+    RawImageHeader header;
+    if (file.open(input, MappedFile::Mode::Read) && readRawImageHeader(file, header)) {
+        width = header.width;
+        height = header.height;
+        return true;
+    }
+    int channels;
+    return stbi_info(input.c_str(), &width, &height, &channels);
+}
+
+// Output file name: the input name without directory nor extension, followed by the width
+static string outputPath(const string& dir, const string& input, int width, const string& format) {
+    size_t name_start = input.find_last_of("/\\");
+    name_start = name_start == string::npos ? 0 : name_start + 1;
+    size_t name_end = input.find_last_of('.');
+    if (name_end == string::npos || name_end < name_start) {
+        name_end = input.size();
+    }
+    return dir + "/" + input.substr(name_start, name_end - name_start) + "_" + to_string(width) + "." + format;
+}
+
+BatchStats runBatch(const vector<BatchJob>& jobs, const BatchOptions& options) {
+    return runBatch(jobs, options, Scheduler::shared());
+}
+
+BatchStats runBatch(const vector<BatchJob>& jobs, const BatchOptions& options, Scheduler& scheduler) {
+    Clock::time_point batch_start = Clock::now();
+    StageCounter decode, carve, encode;
+    atomic<int> images(0), outputs(0), failures(0);
+
+    // Admission of the images in flight
+    mutex admission_lock;
+    int in_flight = 0;
+    size_t memory = 0;
+    size_t peak_memory = 0;
+    size_t peak_image_memory = 0;
+
+    TaskGroup group(scheduler);
+    for (const BatchJob& job : jobs) {
+        int width, height;
+        if (!imageSize(job.input, width, height)) {
+            cerr << "Couldn't load file " << job.input << endl;
+            ++failures;
+            continue;
+        }
+        size_t bytes = estimateImageBytes(width, height, options.settings, job.widths.size());
+
+        // Backpressure: help with the images in flight until this one fits
+        scheduler.waitUntil([&] {
+            lock_guard<mutex> lock(admission_lock);
+            return in_flight == 0 ||
+                   (in_flight < options.maxImagesInFlight &&
+                    (options.memoryCeiling == 0 || memory + bytes <= options.memoryCeiling));
+        });
+        {
+            lock_guard<mutex> lock(admission_lock);
+            ++in_flight;
+            memory += bytes;
+            peak_memory = max(peak_memory, memory);
+        }
+
+        // Released once the last task of the image is done with it
+        shared_ptr<void> admission(nullptr, [&, bytes](void*) {
+            lock_guard<mutex> lock(admission_lock);
+            --in_flight;
+            memory -= bytes;
+        });
+
+        group.run([&, admission] {
+            Clock::time_point decode_start = Clock::now();
+            auto sc = make_shared<SeamCarving>(job.input, options.settings);
+            decode.add(decode_start);
+            if (sc->getCarvedHeight() == 0) {
+                ++failures;
+                return;
+            }
+
+            group.run([&, admission, sc] {
+                vector<int> widths;
+                for (int target : job.widths) {
+                    if (target < 1) {
+                        cerr << "Invalid width " << target << " for " << job.input << endl;
+                        ++failures;
+                    } else if (target > sc->getCarvedWidth()) {
+                        // Seams are only removed: no file is written rather than one of another width
+                        cerr << "Skipping width " << target << " for " << job.input << ", only "
+                             << sc->getCarvedWidth() << " pixels wide" << endl;
+                    } else {
+                        widths.push_back(target);
+                    }
+                }
+
+                // Each width continues the carving of the previous one, its encoding runs meanwhile
+                Clock::time_point carve_start = Clock::now();
+                sc->carveToWidths(widths, [&](int target, const SeamCarving& carved) {
+                    auto image = make_shared<CarvedImage>(carved.snapshot());
+                    carve.add(carve_start);
+
+                    string path = outputPath(options.outputDir, job.input, target, options.outputFormat);
+                    group.run([&, admission, image, path] {
+                        Clock::time_point encode_start = Clock::now();
+                        size_t stride = static_cast<size_t>(image->width) * 4;
+                        bool written = options.outputFormat == "qoi" ?
+                            writeQoi(path, image->rgba.data(), image->width, image->height, stride) :
+                            writePng(path, image->rgba.data(), image->width, image->height, 4, stride, options.png);
+                        if (written) {
+                            ++outputs;
+                        } else {
+                            cerr << "Couldn't write file " << path << endl;
+                            ++failures;
+                        }
+                        encode.add(encode_start);
+                    });
+                    carve_start = Clock::now();
+                });
+                {
+                    lock_guard<mutex> lock(admission_lock);
+                    peak_image_memory = max(peak_image_memory, sc->getMemoryStats().peak);
+                }
+                ++images;
+            });
+        });
+    }
+    group.wait();
+
+    BatchStats stats;
+    stats.images = images;
+    stats.outputs = outputs;
+    stats.failures = failures;
+    stats.seconds = secondsSince(batch_start);
+    stats.threads = scheduler.threadCount();
+    stats.peakMemory = peak_memory;
+    stats.peakImageMemory = peak_image_memory;
+    stats.decode = decode.stats();
+    stats.carve = carve.stats();
+    stats.encode = encode.stats();
+    return stats;
+}
@@ -0,0 +1,67 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "settings.h"
+#include "pngEncoder.h"
+
+using namespace std;
+
+class Scheduler;
+
+// One input image and the widths it is carved to. Each width is written to
+// <outputDir>/<input name without extension>_<width>.<outputFormat>; widths above the width of
+// the image are skipped with a warning.
+struct BatchJob {
+    string input;
+    vector<int> widths;
+};
+
+struct BatchOptions {
+    Settings settings;
+    string outputDir = ".";
+    // Images decoded, carved or encoded at the same time. Decoding the next image waits
+    // for one of them to be done, which bounds the queue between every pair of stages.
+    int maxImagesInFlight = 4;
+    // Estimated bytes the images in flight may use together, 0 means no limit.
+    // One image is always admitted, even if it alone is above the ceiling.
+    size_t memoryCeiling = 0;
+    // "png", or "qoi" for fast lossless files meant to be read again
+    string outputFormat = "png";
+    PngOptions png;
+};
+
+// Time spent in each stage of the pipeline, summed over all threads
+struct BatchStageStats {
+    double busySeconds = 0;
+    int runs = 0;
+};
+
+struct BatchStats {
+    int images = 0;         // images carved
+    int outputs = 0;        // files written
+    int failures = 0;       // images that could not be decoded plus files that could not be written
+    double seconds = 0;     // wall clock time of the whole batch
+    int threads = 1;        // threads of the scheduler running the batch
+    size_t peakMemory = 0;  // highest estimated memory of the images in flight
+    size_t peakImageMemory = 0;  // highest memory measured by a SeamCarving, see getMemoryStats()
+    BatchStageStats decode;
+    BatchStageStats carve;
+    BatchStageStats encode;
+
+    double imagesPerSecond() const { return seconds > 0 ? images / seconds : 0; }
+    // Share of the thread time of the batch spent in a stage
+    double utilization(const BatchStageStats& stage) const {
+        return seconds > 0 ? stage.busySeconds / (seconds * threads) : 0;
+    }
+};
+
+// Carve every job. Decoding, carving and encoding of different images overlap on the
+// threads of the scheduler, the calling thread takes part in the work.
+BatchStats runBatch(const vector<BatchJob>& jobs, const BatchOptions& options);
+BatchStats runBatch(const vector<BatchJob>& jobs, const BatchOptions& options, Scheduler& scheduler);
+
+#endif // BATCH_H
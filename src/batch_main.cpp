@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "batch.h"
+#include "seamEngine.h"
+
+using namespace std;
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " -w WIDTH[,WIDTH...] [options] IMAGE...\n"
+         << "Carve every image to each width, writing <output>/<name>_<width>.<format>\n"
+         << "\n"
+         << "  -w, --widths LIST      comma separated target widths\n"
+         << "  -o, --output DIR       output directory (default: .)\n"
+         << "  -l, --list FILE        also read input images from FILE, one per line\n"
+         << "  -j, --threads N        threads of the shared pool (default: hardware threads)\n"
+         << "  -q, --queue N          images in flight at once (default: 4)\n"
+         << "  -m, --memory MIB       estimated memory ceiling of the images in flight\n"
+         << "  -b, --budget MIB       memory budget of each image, the seam search adapts to it\n"
+         << "      --tasks N          parallel tasks inside each image (default: 1)\n"
+         << "      --out-of-core DIR  keep the images in temporary files in DIR, for images larger than the RAM\n"
+         << "      --forward          forward energy seam search instead of backward\n"
+         << "      --energy NAME      l2, l2sq, l1, luma, sobel, scharr, entropy or hog (default: l2)\n"
+         << "      --luma-plane       with the luma energy, keep a carved luminance plane (the window operators always do)\n"
+         << "      --cost NAME        double, float or fixed (default: double)\n"
+         << "  -f, --format NAME      png or qoi (default: png)\n"
+         << "      --png-level N      PNG compression, 0 (stored) to 9 (default: 6)\n"
+         << "      --png-parallel     compress strips of each PNG in parallel\n";
+}
+
+static bool parseWidths(const string& list, vector<int>& widths) {
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        int width = atoi(item.c_str());
+        if (width < 1) {
+            return false;
+        }
+        widths.push_back(width);
+    }
+    return !widths.empty();
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    options.settings.doBackwardSearch = true;
+    options.settings.showEnergy = false;
+    options.settings.seamsToRemove = 0;
+
+    vector<int> widths;
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if ((arg == "-w" || arg == "--widths") && has_value) {
+            if (!parseWidths(argv[++i], widths)) {
+                cerr << "Invalid widths " << argv[i] << endl;
+                return 2;
+            }
+        } else if ((arg == "-o" || arg == "--output") && has_value) {
+            options.outputDir = argv[++i];
+        } else if ((arg == "-l" || arg == "--list") && has_value) {
+            ifstream list(argv[++i]);
+            if (!list) {
+                cerr << "Couldn't read list " << argv[i] << endl;
+                return 2;
+            }
+            for (string line; getline(list, line);) {
+                if (!line.empty()) {
+                    inputs.push_back(line);
+                }
+            }
+        } else if ((arg == "-j" || arg == "--threads") && has_value) {
+            // The pool is shared with the carving engine, it is sized on first use
+            setenv("SEAMCARVING_THREADS", argv[++i], 1);
+        } else if ((arg == "-q" || arg == "--queue") && has_value) {
+            options.maxImagesInFlight = max(atoi(argv[++i]), 1);
+        } else if ((arg == "-m" || arg == "--memory") && has_value) {
+            options.memoryCeiling = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+        } else if ((arg == "-b" || arg == "--budget") && has_value) {
+            options.settings.memoryBudget = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+        } else if (arg == "--out-of-core" && has_value) {
+            options.settings.outOfCore = true;
+            options.settings.spillDirectory = argv[++i];
+        } else if (arg == "--tasks" && has_value) {
+            options.settings.seamThreads = max(atoi(argv[++i]), 1);
+        } else if (arg == "--forward") {
+            options.settings.doBackwardSearch = false;
+        } else if (arg == "--energy" && has_value) {
+            string name = argv[++i];
+            if (name == "l2") {
+                options.settings.energyMetric = EnergyMetric::L2;
+            } else if (name == "l2sq") {
+                options.settings.energyMetric = EnergyMetric::L2Squared;
+            } else if (name == "l1") {
+                options.settings.energyMetric = EnergyMetric::L1;
+            } else if (name == "luma") {
+                options.settings.energyMetric = EnergyMetric::Luminance;
+            } else if (name == "sobel") {
+                options.settings.energyMetric = EnergyMetric::Sobel;
+            } else if (name == "scharr") {
+                options.settings.energyMetric = EnergyMetric::Scharr;
+            } else if (name == "entropy") {
+                options.settings.energyMetric = EnergyMetric::Entropy;
+            } else if (name == "hog") {
+                options.settings.energyMetric = EnergyMetric::HogWeighted;
+            } else {
+                cerr << "Unknown energy " << name << endl;
+                return 2;
+            }
+        } else if (arg == "--luma-plane") {
+            options.settings.luminancePlane = true;
+        } else if (arg == "--cost" && has_value) {
+            string name = argv[++i];
+            if (name == "double") {
+                options.settings.costType = CostType::Double;
+            } else if (name == "float") {
+                options.settings.costType = CostType::Float;
+            } else if (name == "fixed") {
+                options.settings.costType = CostType::Fixed;
+            } else {
+                cerr << "Unknown cost type " << name << endl;
+                return 2;
+            }
+        } else if ((arg == "-f" || arg == "--format") && has_value) {
+            options.outputFormat = argv[++i];
+            if (options.outputFormat != "png" && options.outputFormat != "qoi") {
+                cerr << "Unknown format " << options.outputFormat << endl;
+                return 2;
+            }
+        } else if (arg == "--png-level" && has_value) {
+            options.png.level = atoi(argv[++i]);
+            if (options.png.level < 0 || options.png.level > 9) {
+                cerr << "Invalid PNG level " << argv[i] << endl;
+                return 2;
+            }
+        } else if (arg == "--png-parallel") {
+            options.png.parallel = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (widths.empty() || inputs.empty()) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    vector<BatchJob> jobs;
+    for (const string& input : inputs) {
+        jobs.push_back(BatchJob{input, widths});
+    }
+
+    BatchStats stats = runBatch(jobs, options);
+
+    printf("%d images, %d files written, %d failures\n", stats.images, stats.outputs, stats.failures);
+    printf("%.2f s on %d threads, %.2f images/s, %s engine\n", stats.seconds, stats.threads, stats.imagesPerSecond(),
+           seamIsaName(seamEngineIsa(options.settings)));
+    printf("peak memory estimate %.1f MiB, largest image %.1f MiB measured\n", stats.peakMemory / (1024.0 * 1024.0),
+           stats.peakImageMemory / (1024.0 * 1024.0));
+    const pair<const char*, const BatchStageStats*> stages[] = {
+        {"decode", &stats.decode}, {"carve", &stats.carve}, {"encode", &stats.encode}};
+    for (const auto& stage : stages) {
+        printf("%-7s %6d runs %8.2f s busy %5.1f%% utilization\n", stage.first, stage.second->runs,
+               stage.second->busySeconds, 100.0 * stats.utilization(*stage.second));
+    }
+    return stats.failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef COSTTYPES_H
+#define COSTTYPES_H
+
+#include <cstdint>
+#include <limits>
+
+// Arithmetic used by the energy map and the seam search for each supported cost type.
+// Energies are computed in double precision and converted with fromReal(), `scale` being the
+// fixed-point scale factor (ignored by the floating-point types).
+template <typename Cost>
+struct CostTraits;
+
+template <>
+struct CostTraits<double> {
+    static double infinity() { return std::numeric_limits<double>::max(); }
+    static double fromReal(double v, double) { return v; }
+    static double toReal(double v, double) { return v; }
+    static double add(double a, double b) { return a + b; }
+};
+
+template <>
+struct CostTraits<float> {
+    static float infinity() { return std::numeric_limits<float>::max(); }
+    static float fromReal(double v, double) { return static_cast<float>(v); }
+    static double toReal(float v, double) { return v; }
+    static float add(float a, float b) { return a + b; }
+};
+
+// Unsigned fixed-point, saturating instead of wrapping around on overflow
+template <>
+struct CostTraits<uint32_t> {
+    static uint32_t infinity() { return std::numeric_limits<uint32_t>::max(); }
+    static uint32_t fromReal(double v, double scale) {
+        double s = v * scale + 0.5;
+        return s >= 4294967295.0 ? infinity() : static_cast<uint32_t>(s);
+    }
+    static double toReal(uint32_t v, double scale) { return v / scale; }
+    static uint32_t add(uint32_t a, uint32_t b) {
+        uint32_t s = a + b;
+        return s < a ? infinity() : s;
+    }
+};
+
+#endif // COSTTYPES_H
@@ -0,0 +1,312 @@
+#ifndef ENERGYKERNELS_H
+#define ENERGYKERNELS_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+#include "seamCarving.h"
+
+// Energy metrics. diff() is the integer difference between two pixels, energy() turns
+// the sum of the horizontal and vertical differences of a pixel into its energy.
+// Everything up to energy() stays in 32 bits integers so that the row loops vectorize.
+// Channels is 3 to compare the colour channels only, 4 to also compare alpha.
+// The energy of a pixel depends on the pixels up to `radius` rows and columns away from it.
+// Windowed metrics compute it with windowRow() over the 2 * radius + 1 rows around the pixel
+// instead of summing diff(); diff() then only gives the forward energy of the seam edges.
+template <int Channels>
+struct L2Metric {
+    static constexpr int radius = 1;
+    static constexpr bool windowed = false;
+    static int32_t diff(const Pixel& a, const Pixel& b) {
+        int32_t dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        int32_t d = dr * dr + dg * dg + db * db;
+        if (Channels == 4) {
+            int32_t da = a.a - b.a;
+            d += da * da;
+        }
+        return d;
+    }
+    static double energy(int32_t gradient) { return std::sqrt(static_cast<double>(gradient)); }
+    static double maxDiff() { return Channels * 255.0 * 255.0; }
+    static double maxEnergy() { return std::sqrt(2 * maxDiff()); }
+};
+
+template <int Channels>
+struct L2SquaredMetric {
+    static constexpr int radius = 1;
+    static constexpr bool windowed = false;
+    static int32_t diff(const Pixel& a, const Pixel& b) { return L2Metric<Channels>::diff(a, b); }
+    static double energy(int32_t gradient) { return gradient; }
+    static double maxDiff() { return Channels * 255.0 * 255.0; }
+    static double maxEnergy() { return 2 * maxDiff(); }
+};
+
+template <int Channels>
+struct L1Metric {
+    static constexpr int radius = 1;
+    static constexpr bool windowed = false;
+    static int32_t diff(const Pixel& a, const Pixel& b) {
+        int32_t d = std::abs(a.r - b.r) + std::abs(a.g - b.g) + std::abs(a.b - b.b);
+        if (Channels == 4) {
+            d += std::abs(a.a - b.a);
+        }
+        return d;
+    }
+    static double energy(int32_t gradient) { return gradient; }
+    static double maxDiff() { return Channels * 255.0; }
+    static double maxEnergy() { return 2 * maxDiff(); }
+};
+
+// Luminance and alpha of a pixel, read from the planes of the luminance layout
+struct LumaPixel {
+    uint8_t y;
+    uint8_t a;
+};
+
+// ITU-R BT.601 luma with 8 bits weights
+inline int32_t lumaOf(const Pixel& p) { return (77 * p.r + 150 * p.g + 29 * p.b + 128) >> 8; }
+inline int32_t lumaOf(const LumaPixel& p) { return p.y; }
+
+template <int Channels>
+struct LuminanceMetric {
+    static constexpr int radius = 1;
+    static constexpr bool windowed = false;
+    static int32_t luma(const Pixel& p) { return lumaOf(p); }
+    static int32_t diff(const Pixel& a, const Pixel& b) {
+        int32_t d = std::abs(luma(a) - luma(b));
+        if (Channels == 4) {
+            d += std::abs(a.a - b.a);
+        }
+        return d;
+    }
+    // Same difference from the luma already computed
+    static int32_t diff(const LumaPixel& a, const LumaPixel& b) {
+        int32_t d = std::abs(a.y - b.y);
+        if (Channels == 4) {
+            d += std::abs(a.a - b.a);
+        }
+        return d;
+    }
+    static double energy(int32_t gradient) { return gradient; }
+    static double maxDiff() { return (Channels == 4 ? 2 : 1) * 255.0; }
+    static double maxEnergy() { return 2 * maxDiff(); }
+};
+
+// Row accessors of the two pixel layouts. The kernels below only use row[x], which for
+// the planar layout loads each channel from its own plane so that no shuffle is needed.
+struct InterleavedRow {
+    const Pixel* pixels;
+    Pixel operator[](int x) const { return pixels[x]; }
+};
+
+struct PlanarRow {
+    const uint8_t* r;
+    const uint8_t* g;
+    const uint8_t* b;
+    const uint8_t* a;
+    Pixel operator[](int x) const { return Pixel{r[x], g[x], b[x], a[x]}; }
+};
+
+// Rows of the luminance layout, `a` is the alpha plane, or the luma plane again when alpha
+// does not count in the energy
+struct LuminanceRow {
+    const uint8_t* y;
+    const uint8_t* a;
+    LumaPixel operator[](int x) const { return LumaPixel{y[x], a[x]}; }
+};
+
+// The kernels read up to two pixels past both ends of the rows, which must hold the
+// mirrored border of the image (see SeamContext).
+
+// Gradient of the pixels [begin, end) of a row given the rows above and below it.
+// Differences across the image border count as 0: the mirrored border takes care of the
+// columns, pass up == down for the first and last rows.
+template <typename Metric, typename Row>
+void gradientRow(Row up, Row mid, Row down, int begin, int end, int32_t* out) {
+    for (int x = begin; x < end; ++x) {
+        out[x] = Metric::diff(down[x], up[x]) + Metric::diff(mid[x + 1], mid[x - 1]);
+    }
+}
+
+// Operators of the luma (and alpha, the second sample, when Channels is 4) over a window of
+// rows. Their rows come from any layout, the luminance layout included.
+template <int Channels>
+struct LumaWindowMetric {
+    static constexpr bool windowed = true;
+    static constexpr int samples = Channels == 4 ? 2 : 1;
+
+    template <typename P>
+    static int32_t sample(const P& p, int c) { return c == 0 ? lumaOf(p) : p.a; }
+
+    template <typename P>
+    static int32_t diff(const P& a, const P& b) {
+        int32_t d = 0;
+        for (int c = 0; c < samples; ++c) {
+            d += std::abs(sample(a, c) - sample(b, c));
+        }
+        return d;
+    }
+    static double maxDiff() { return samples * 255.0; }
+
+    // |dx| + |dy| of the central differences at x of rows[k]
+    template <typename Row>
+    static int32_t centralGradient(const Row* rows, int k, int x) {
+        return diff(rows[k][x + 1], rows[k][x - 1]) + diff(rows[k + 1][x], rows[k - 1][x]);
+    }
+};
+
+// 3x3 derivative kernels, Side and Center being the weights of the smoothing across the
+// derivative: [Side Center Side]. The energy is the L2 norm of both derivatives.
+template <int Channels, int Side, int Center>
+struct DerivativeMetric : LumaWindowMetric<Channels> {
+    using Base = LumaWindowMetric<Channels>;
+    static constexpr int radius = 1;
+
+    template <typename Row>
+    static void windowRow(const Row* rows, int begin, int end, int32_t* out) {
+        const Row& up = rows[0];
+        const Row& mid = rows[1];
+        const Row& down = rows[2];
+        for (int x = begin; x < end; ++x) {
+            int32_t g = 0;
+            for (int c = 0; c < Base::samples; ++c) {
+                int32_t dx = Side * (Base::sample(up[x + 1], c) - Base::sample(up[x - 1], c)) +
+                             Center * (Base::sample(mid[x + 1], c) - Base::sample(mid[x - 1], c)) +
+                             Side * (Base::sample(down[x + 1], c) - Base::sample(down[x - 1], c));
+                int32_t dy = Side * (Base::sample(down[x - 1], c) - Base::sample(up[x - 1], c)) +
+                             Center * (Base::sample(down[x], c) - Base::sample(up[x], c)) +
+                             Side * (Base::sample(down[x + 1], c) - Base::sample(up[x + 1], c));
+                g += dx * dx + dy * dy;
+            }
+            out[x] = g;
+        }
+    }
+    static double energy(int32_t gradient) { return std::sqrt(static_cast<double>(gradient)); }
+    static double maxEnergy() {
+        double max_derivative = (2 * Side + Center) * 255.0;
+        return std::sqrt(2 * Base::samples * max_derivative * max_derivative);
+    }
+};
+
+template <int Channels>
+using SobelMetric = DerivativeMetric<Channels, 1, 2>;
+
+template <int Channels>
+using ScharrMetric = DerivativeMetric<Channels, 3, 10>;
+
+// Central gradient plus the entropy of the luma over a 5x5 window, quantized to 16 levels.
+// The window slides along the row, each step only moves one column of the histogram.
+template <int Channels>
+struct EntropyMetric : LumaWindowMetric<Channels> {
+    using Base = LumaWindowMetric<Channels>;
+    static constexpr int radius = 2;
+    static constexpr int windowSize = (2 * radius + 1) * (2 * radius + 1);
+    // Energies are kept in 1/256 units. A window of all different levels, log2(25) bits,
+    // weighs as much as a full luma step.
+    static constexpr int32_t unit = 256;
+    static constexpr int32_t maxEntropy = 255 * unit;
+
+    // c * log2(c) of every count, in the units of the energy, divided by the window size:
+    // the entropy of a window is maxEntropy minus the sum over its levels
+    static const std::array<int32_t, windowSize + 1>& weights() {
+        static const std::array<int32_t, windowSize + 1> table = [] {
+            std::array<int32_t, windowSize + 1> t{};
+            for (int c = 1; c <= windowSize; ++c) {
+                t[c] = static_cast<int32_t>(std::lround(maxEntropy * c * std::log2(static_cast<double>(c)) /
+                                                        (windowSize * std::log2(static_cast<double>(windowSize)))));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    template <typename Row>
+    static void windowRow(const Row* rows, int begin, int end, int32_t* out) {
+        const std::array<int32_t, windowSize + 1>& weight = weights();
+        int counts[16] = {};
+        int32_t sum = 0;
+        auto slide = [&](int x, int step) {
+            for (int k = 0; k <= 2 * radius; ++k) {
+                int level = lumaOf(rows[k][x]) >> 4;
+                sum -= weight[counts[level]];
+                counts[level] += step;
+                sum += weight[counts[level]];
+            }
+        };
+        for (int x = begin - radius; x < begin + radius; ++x) {
+            slide(x, 1);
+        }
+        for (int x = begin; x < end; ++x) {
+            slide(x + radius, 1);
+            out[x] = Base::centralGradient(rows, radius, x) * unit + maxEntropy - sum;
+            slide(x - radius, -1);
+        }
+    }
+    static double energy(int32_t gradient) { return gradient / static_cast<double>(unit); }
+    static double maxEnergy() { return 2 * Base::maxDiff() + 255.0; }
+};
+
+// Central gradient divided by the largest bin of the histogram of the gradient orientations
+// over the 3x3 pixels around: pixels among edges of the same direction cost less. The
+// orientations need the neighbours of the window pixels, hence a radius of 2.
+template <int Channels>
+struct HogMetric : LumaWindowMetric<Channels> {
+    using Base = LumaWindowMetric<Channels>;
+    static constexpr int radius = 2;
+    static constexpr int32_t unit = 256;
+    static constexpr int flat = 8;
+
+    // Orientation of the luma gradient at x of rows[k] in 8 bins of 22.5 degrees over
+    // [0, 180), or `flat` without any gradient. tan(22.5) ~ 106 / 256, tan(67.5) ~ 618 / 256.
+    template <typename Row>
+    static int orientation(const Row* rows, int k, int x) {
+        int32_t gx = lumaOf(rows[k][x + 1]) - lumaOf(rows[k][x - 1]);
+        int32_t gy = lumaOf(rows[k + 1][x]) - lumaOf(rows[k - 1][x]);
+        if (gy < 0 || (gy == 0 && gx < 0)) {
+            gx = -gx;
+            gy = -gy;
+        }
+        if (gy == 0 && gx == 0) {
+            return flat;
+        }
+        int32_t ax = std::abs(gx);
+        int bin = gy * 256 < 106 * ax ? 0 : gy < ax ? 1 : gy * 256 < 618 * ax ? 2 : 3;
+        return gx >= 0 ? bin : 7 - bin;
+    }
+
+    template <typename Row>
+    static void windowRow(const Row* rows, int begin, int end, int32_t* out) {
+        int counts[flat + 1] = {};
+        auto slide = [&](int x, int step) {
+            for (int k = radius - 1; k <= radius + 1; ++k) {
+                counts[orientation(rows, k, x)] += step;
+            }
+        };
+        slide(begin - 1, 1);
+        slide(begin, 1);
+        for (int x = begin; x < end; ++x) {
+            slide(x + 1, 1);
+            int largest = std::max(*std::max_element(counts, counts + flat), 1);
+            out[x] = Base::centralGradient(rows, radius, x) * unit / largest;
+            slide(x - 1, -1);
+        }
+    }
+    static double energy(int32_t gradient) { return gradient / static_cast<double>(unit); }
+    static double maxEnergy() { return 2 * Base::maxDiff(); }
+};
+
+// Forward energy of the edges created in the pixels [begin, end) of row `cur` when the seam
+// comes from the upper left (pixels x and x - 2 of `up` become neighbours) or from the upper
+// right (x and x + 2).
+template <typename Metric, typename Row>
+void seamEdgeRow(Row up, Row cur, int begin, int end, int32_t* from_left, int32_t* from_right) {
+    for (int x = begin; x < end; ++x) {
+        from_left[x] = Metric::diff(cur[x], up[x - 2]);
+        from_right[x] = Metric::diff(cur[x], up[x + 2]);
+    }
+}
+
+#endif // ENERGYKERNELS_H
@@ -12,16 +12,16 @@
 #include <SDL3/SDL_opengl.h>
 #endif
 
-#define STB_IMAGE_IMPLEMENTATION
 #include "../libs/stb_image.h"
 
 #include "seamCarving.h"
+#include "seamEngine.h"
 #include "settings.h"
 
 #define WINDOW_SIZE_X 1000
 #define WINDOW_SIZE_Y 800
 #define SETTING_WINDOW_SIZE_X 400
-#define SETTING_WINDOW_SIZE_Y 200
+#define SETTING_WINDOW_SIZE_Y 315
 
 // Simple helper function to load an image into a OpenGL texture with common settings
 bool LoadTextureFromFile(const char* filename, GLuint* out_texture, int* out_width, int* out_height) {
@@ -57,7 +57,8 @@ bool LoadTextureFromFile(const char* filename, GLuint* out_texture, int* out_wid
     return true;
 }
 
-bool LoadTexture(const unsigned char* image_data, GLuint* out_texture, int image_width, int image_height) {
+// row_length is the distance between two rows in pixels, 0 when they are packed
+bool LoadTexture(const unsigned char* image_data, GLuint* out_texture, int image_width, int image_height, int row_length = 0) {
     // Create a OpenGL texture identifier
     GLuint image_texture;
     glGenTextures(1, &image_texture);
@@ -71,9 +72,12 @@ bool LoadTexture(const unsigned char* image_data, GLuint* out_texture, int image
 
     // Upload pixels into texture
 #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
 #endif
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
 
     *out_texture = image_texture;
 
@@ -219,6 +223,8 @@ int main(int, char**) {
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(padding, padding));
 
         ImGui::Text("Image Controls");
+        ImGui::SameLine();
+        ImGui::TextDisabled("(kernels: %s)", seamIsaName(seamEngineIsa(sc.settings)));
         
         ImGui::Spacing(); 
         ImGui::Separator();
@@ -233,20 +239,49 @@ int main(int, char**) {
 
         ImGui::Checkbox("Use backward seam search", &newSettings.doBackwardSearch);
 
+        ImGui::Spacing(); 
+
+        const char* cost_types[] = { "double", "float", "fixed-point" };
+        int cost_type = static_cast<int>(newSettings.costType);
+        ImGui::Combo("Cost type", &cost_type, cost_types, IM_ARRAYSIZE(cost_types));
+        newSettings.costType = static_cast<CostType>(cost_type);
+
+        const char* energy_metrics[] = { "L2", "squared L2", "L1", "luminance", "Sobel", "Scharr", "entropy", "HoG-weighted" };
+        int energy_metric = static_cast<int>(newSettings.energyMetric);
+        ImGui::Combo("Energy", &energy_metric, energy_metrics, IM_ARRAYSIZE(energy_metrics));
+        newSettings.energyMetric = static_cast<EnergyMetric>(energy_metric);
+
+        ImGui::Checkbox("Alpha edges in energy", &newSettings.alphaInEnergy);
+        ImGui::Checkbox("Planar channel layout", &newSettings.planarLayout);
+        ImGui::Checkbox("Cached luminance plane", &newSettings.luminancePlane);
+        ImGui::SliderInt("Parallel tasks", &newSettings.seamThreads, 1, 16);
+
         ImGui::PopStyleVar(); 
         
 
         if (!sc.settings.isEqual(newSettings)) {
             sc.carve(newSettings.seamsToRemove);
             if (newSettings.showEnergy) {
-                sc.saveEnergyToFile("../images/energy.png");
+                // Only read back once, stored without compression
+                PngOptions stored;
+                stored.level = 0;
+                sc.saveEnergyToFile("../images/energy.png", stored);
                 bool ret = LoadTextureFromFile("../images/energy.png", &my_image_texture, &my_image_width, &my_image_height);
                 IM_ASSERT(ret);
             }
             else {
-                sc.saveCarvedImageToFile("../images/out.png");
-                bool ret = LoadTextureFromFile("../images/out.png", &my_image_texture, &my_image_width, &my_image_height);
+                // Upload the carved rows straight from the carving buffer
+                CarvedView view = sc.getCarvedView();
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+                bool ret = LoadTexture(reinterpret_cast<const unsigned char*>(view.data), &my_image_texture, view.width, view.height, view.stride);
+#else
+                // No row length to skip the padding of the rows, upload a packed copy
+                CarvedImage image = sc.snapshot();
+                bool ret = LoadTexture(image.rgba.data(), &my_image_texture, view.width, view.height);
+#endif
                 IM_ASSERT(ret);
+                my_image_width = view.width;
+                my_image_height = view.height;
             }
             sc = SeamCarving("../images/castle_orig.png", newSettings);
         }
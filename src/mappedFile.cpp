@@ -0,0 +1,175 @@
+#include "mappedFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SEAM_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        swap(m_data, other.m_data);
+        swap(m_size, other.m_size);
+        swap(m_fd, other.m_fd);
+        swap(m_mode, other.m_mode);
+        swap(m_temporaryPath, other.m_temporaryPath);
+        swap(m_path, other.m_path);
+    }
+    return *this;
+}
+
+#ifdef SEAM_HAS_MMAP
+
+bool MappedFile::open(const string& path, Mode mode) {
+    close();
+    int fd = ::open(path.c_str(), mode == Mode::ReadWrite ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    int protection = mode == Mode::Read ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == Mode::ReadWrite ? MAP_SHARED : MAP_PRIVATE;
+    void* data = mmap(nullptr, info.st_size, protection, flags, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    m_data = static_cast<unsigned char*>(data);
+    m_size = info.st_size;
+    m_fd = fd;
+    m_mode = mode;
+    return true;
+}
+
+bool MappedFile::create(const string& path, size_t size) {
+    close();
+    // Truncating `path` would change the pages of a private mapping of it that were not copied yet
+    string temporary_path = path + ".XXXXXX";
+    int fd = mkstemp(&temporary_path[0]);
+    if (fd < 0) {
+        return false;
+    }
+    if (size == 0 || fchmod(fd, 0644) != 0 || ftruncate(fd, size) != 0) {
+        ::close(fd);
+        unlink(temporary_path.c_str());
+        return false;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    m_data = static_cast<unsigned char*>(data);
+    m_size = size;
+    m_fd = fd;
+    m_mode = Mode::ReadWrite;
+    m_temporaryPath = temporary_path;
+    m_path = path;
+    return true;
+}
+
+bool MappedFile::createTemporary(const string& directory, size_t size) {
+    close();
+    string path = directory + "/seamcarving-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        return false;
+    }
+    // The mapping keeps the file alive, nobody else can open it
+    unlink(path.c_str());
+    if (size == 0 || ftruncate(fd, size) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    m_data = static_cast<unsigned char*>(data);
+    m_size = size;
+    m_fd = fd;
+    m_mode = Mode::Temporary;
+    return true;
+}
+
+void MappedFile::advise(Access access) {
+    if (!m_data) {
+        return;
+    }
+    int advice = access == Access::Sequential ? POSIX_MADV_SEQUENTIAL :
+                 access == Access::Random ? POSIX_MADV_RANDOM : POSIX_MADV_NORMAL;
+    posix_madvise(m_data, m_size, advice);
+}
+
+bool MappedFile::close() {
+    if (!m_data) {
+        return true;
+    }
+    bool ok = true;
+    if (m_mode == Mode::ReadWrite) {
+        ok = msync(m_data, m_size, MS_SYNC) == 0;
+    }
+    ok = munmap(m_data, m_size) == 0 && ok;
+    ok = ::close(m_fd) == 0 && ok;
+    if (!m_temporaryPath.empty()) {
+        ok = ok && rename(m_temporaryPath.c_str(), m_path.c_str()) == 0;
+        if (!ok) {
+            unlink(m_temporaryPath.c_str());
+        }
+        m_temporaryPath.clear();
+        m_path.clear();
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_fd = -1;
+    return ok;
+}
+
+#else
+
+bool MappedFile::open(const string&, Mode) {
+    return false;
+}
+
+bool MappedFile::create(const string&, size_t) {
+    return false;
+}
+
+bool MappedFile::createTemporary(const string&, size_t) {
+    return false;
+}
+
+void MappedFile::advise(Access) {
+}
+
+bool MappedFile::close() {
+    return true;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// File mapped in memory, unmapped and closed on destruction. POSIX only: on other platforms
+// every mapping fails and callers fall back to regular reads and writes.
+class MappedFile {
+public:
+    enum class Mode {
+        Read,       // read-only view of the file
+        Private,    // writable, copy-on-write: changes never reach the file
+        ReadWrite,  // writable, changes are written back to the file
+        Temporary   // writable, the file is deleted as soon as created and never synced
+    };
+
+    // How the mapping is about to be accessed, a hint for the paging of the system
+    enum class Access {
+        Normal,
+        Sequential, // whole rows from top to bottom: read ahead, drop the pages behind
+        Random
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a whole existing file, false if it could not be opened or mapped
+    bool open(const std::string& path, Mode mode);
+    // Create a file of `size` bytes and map it in ReadWrite mode. It is written next to `path` and
+    // renamed over it by close(), so that mappings of the file it replaces keep their contents.
+    bool create(const std::string& path, size_t size);
+    // Create an anonymous file of `size` bytes in `directory` and map it in Temporary mode: the
+    // system pages it in and out of memory, and its space is freed when it is unmapped
+    bool createTemporary(const std::string& directory, size_t size);
+    void advise(Access access);
+    // Write the changes back to the file (ReadWrite only), then unmap it. A created file is
+    // renamed to its path, or removed if it could not be written.
+    bool close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    unsigned char* data() { return m_data; }
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+    int m_fd = -1;
+    Mode m_mode = Mode::Read;
+    // Of a created file: where it is written, and renamed to when closed
+    std::string m_temporaryPath;
+    std::string m_path;
+};
+
+#endif // MAPPEDFILE_H
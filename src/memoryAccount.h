@@ -0,0 +1,69 @@
+#ifndef MEMORYACCOUNT_H
+#define MEMORYACCOUNT_H
+
+#include <algorithm>
+#include <cstddef>
+
+// What the memory of a SeamCarving is used for
+enum class MemoryUse {
+    Pixels,     // the image with its borders (a mapped .scraw file counts its pixel rows)
+    Planes,     // the planar copy of the pixels
+    Energy,
+    Search,     // scratch of the seam search: dp rows and back-pointers, or checkpoints
+    Seams,      // the current seam, the removed ones and the row buffers of the engine
+    Count
+};
+
+// Steps of the life of a SeamCarving, each one with its own peak
+enum class MemoryPhase {
+    Load,       // construction: decoding, first energy, buffers of the engine
+    Carve,      // seam searches and removals
+    Count
+};
+
+// Live bytes of each use, and the peaks of their total
+struct MemoryStats {
+    size_t live[static_cast<int>(MemoryUse::Count)] = {};
+    size_t peakOfPhase[static_cast<int>(MemoryPhase::Count)] = {};
+    size_t totalLive = 0;
+    size_t peak = 0;
+    // Out of core buffers, in temporary files paged by the system and not counted above
+    size_t spilled = 0;
+
+    size_t liveBytes(MemoryUse use) const { return live[static_cast<int>(use)]; }
+    size_t peakBytes(MemoryPhase phase) const { return peakOfPhase[static_cast<int>(phase)]; }
+};
+
+// Bytes held by the buffers of one owner. The owner reports the size of a use whenever the
+// buffers of that use are allocated, grown or released.
+class MemoryAccount {
+public:
+    void set(MemoryUse use, size_t bytes) {
+        size_t& live = m_stats.live[static_cast<int>(use)];
+        m_stats.totalLive = m_stats.totalLive - live + bytes;
+        live = bytes;
+        m_stats.peak = std::max(m_stats.peak, m_stats.totalLive);
+        size_t& phase_peak = m_stats.peakOfPhase[static_cast<int>(m_phase)];
+        phase_peak = std::max(phase_peak, m_stats.totalLive);
+    }
+
+    void setSpilled(size_t bytes) {
+        m_stats.spilled = bytes;
+    }
+
+    void setPhase(MemoryPhase phase) {
+        m_phase = phase;
+        size_t& phase_peak = m_stats.peakOfPhase[static_cast<int>(m_phase)];
+        phase_peak = std::max(phase_peak, m_stats.totalLive);
+    }
+
+    size_t live() const { return m_stats.totalLive; }
+    size_t live(MemoryUse use) const { return m_stats.liveBytes(use); }
+    const MemoryStats& stats() const { return m_stats; }
+
+private:
+    MemoryStats m_stats;
+    MemoryPhase m_phase = MemoryPhase::Load;
+};
+
+#endif // MEMORYACCOUNT_H
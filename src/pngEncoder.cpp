@@ -0,0 +1,521 @@
+#include "pngEncoder.h"
+#include "scheduler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// The encoder reuses the CRC of stb, which is only visible in this file
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../libs/stb_image_write.h"
+
+using namespace std;
+
+namespace {
+
+constexpr int windowSize = 32768;
+constexpr int hashBits = 15;
+constexpr int minMatch = 3;
+constexpr int maxMatch = 258;
+constexpr int maxStoredBlock = 65535;
+// Filtered bytes per strip. Strips are filtered and compressed on their own, which also keeps
+// every offset inside a strip well within an int.
+constexpr size_t stripBytes = 1 << 20;
+
+struct LevelParams {
+    int chain;  // candidates tried per position
+    int nice;   // match length that ends the search
+    bool lazy;  // look for a longer match at the next byte before taking one
+};
+
+const LevelParams levelParams[10] = {
+    {0, 0, false},    {4, 8, false},    {8, 16, false},    {16, 32, false},   {16, 32, true},
+    {32, 64, true},   {64, 128, true},  {128, 258, true},  {256, 258, true},  {1024, 258, true}};
+
+const uint16_t lengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t distanceBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,    65,    97,    129,
+                                   193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+uint32_t reverseBits(uint32_t code, int bits) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < bits; ++i) {
+        reversed = reversed << 1 | (code >> i & 1);
+    }
+    return reversed;
+}
+
+// Fixed Huffman codes of deflate, reversed to be written LSB first, and the symbol of each
+// match length and distance
+struct FixedCodes {
+    uint16_t literal[288];
+    uint8_t literalBits[288];
+    uint8_t distance[30];
+    uint8_t lengthSymbol[maxMatch + 1];
+    // Distances up to 256 at d - 1, longer ones at 256 + (d - 1) / 128
+    uint8_t distanceSymbol[512];
+
+    FixedCodes() {
+        for (int symbol = 0; symbol < 288; ++symbol) {
+            if (symbol < 144) {
+                literalBits[symbol] = 8;
+                literal[symbol] = reverseBits(0x30 + symbol, 8);
+            } else if (symbol < 256) {
+                literalBits[symbol] = 9;
+                literal[symbol] = reverseBits(0x190 + symbol - 144, 9);
+            } else if (symbol < 280) {
+                literalBits[symbol] = 7;
+                literal[symbol] = reverseBits(symbol - 256, 7);
+            } else {
+                literalBits[symbol] = 8;
+                literal[symbol] = reverseBits(0xc0 + symbol - 280, 8);
+            }
+        }
+        for (int code = 0; code < 30; ++code) {
+            distance[code] = reverseBits(code, 5);
+            for (int d = distanceBase[code]; d < distanceBase[code] + (1 << distanceExtra[code]); ++d) {
+                distanceSymbol[d <= 256 ? d - 1 : 256 + ((d - 1) >> 7)] = code;
+            }
+        }
+        for (int code = 0; code < 29; ++code) {
+            int last = code == 28 ? maxMatch : lengthBase[code + 1] - 1;
+            for (int length = lengthBase[code]; length <= last; ++length) {
+                lengthSymbol[length] = code;
+            }
+        }
+    }
+};
+
+const FixedCodes& fixedCodes() {
+    static const FixedCodes codes;
+    return codes;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(vector<unsigned char>& out) : m_out(out) {}
+
+    void put(uint32_t value, int bits) {
+        m_bits |= static_cast<uint64_t>(value) << m_count;
+        m_count += bits;
+        while (m_count >= 8) {
+            m_out.push_back(static_cast<unsigned char>(m_bits));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void align() {
+        if (m_count > 0) {
+            put(0, 8 - m_count);
+        }
+    }
+
+private:
+    vector<unsigned char>& m_out;
+    uint64_t m_bits = 0;
+    int m_count = 0;
+};
+
+struct Match {
+    int length = 0;
+    int distance = 0;
+};
+
+// Hash chains over the window of one strip, positions are offsets from the start of the window
+class MatchFinder {
+public:
+    MatchFinder(const unsigned char* window, int size, const LevelParams& params)
+        : m_window(window), m_size(size), m_params(params), m_head(1 << hashBits, -1), m_prev(windowSize) {}
+
+    void insert(int pos) {
+        if (pos + minMatch <= m_size) {
+            uint32_t h = hash(pos);
+            m_prev[pos & (windowSize - 1)] = m_head[h];
+            m_head[h] = pos;
+        }
+    }
+
+    // Longest match of the bytes at `pos` ending before `end`
+    Match find(int pos, int end) const {
+        Match best;
+        int limit = min(maxMatch, end - pos);
+        if (limit < minMatch) {
+            return best;
+        }
+        const unsigned char* current = m_window + pos;
+        int best_length = minMatch - 1;
+        int candidate = m_head[hash(pos)];
+        for (int chain = m_params.chain; candidate >= 0 && pos - candidate <= windowSize && chain > 0; --chain) {
+            const unsigned char* previous = m_window + candidate;
+            if (previous[best_length] == current[best_length] && previous[0] == current[0]) {
+                int length = 0;
+                while (length < limit && previous[length] == current[length]) {
+                    ++length;
+                }
+                if (length > best_length) {
+                    best_length = length;
+                    best.length = length;
+                    best.distance = pos - candidate;
+                    if (length >= m_params.nice || length == limit) {
+                        break;
+                    }
+                }
+            }
+            // A slot overwritten by a newer position ends the chain
+            int next = m_prev[candidate & (windowSize - 1)];
+            if (next >= candidate) {
+                break;
+            }
+            candidate = next;
+        }
+        return best;
+    }
+
+private:
+    uint32_t hash(int pos) const {
+        const unsigned char* p = m_window + pos;
+        uint32_t bytes = static_cast<uint32_t>(p[0]) << 16 | static_cast<uint32_t>(p[1]) << 8 | p[2];
+        return (bytes * 2654435761u) >> (32 - hashBits);
+    }
+
+    const unsigned char* m_window;
+    int m_size;
+    const LevelParams& m_params;
+    vector<int> m_head;
+    vector<int> m_prev;
+};
+
+void putStored(const unsigned char* data, size_t size, vector<unsigned char>& out) {
+    for (size_t done = 0; done < size;) {
+        size_t length = min(size - done, static_cast<size_t>(maxStoredBlock));
+        // Not final, no compression: the header bits are padded to the next byte
+        const unsigned char header[5] = {0, static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+                                         static_cast<unsigned char>(~length), static_cast<unsigned char>(~length >> 8)};
+        out.insert(out.end(), header, header + 5);
+        out.insert(out.end(), data + done, data + done + length);
+        done += length;
+    }
+}
+
+// Deflate data[begin, end) into non-final blocks that end on a byte boundary, so that the blocks
+// of the next strip can follow. Matches reach back up to the window size before `begin`.
+void deflateStrip(const unsigned char* data, size_t begin, size_t end, int level, vector<unsigned char>& out) {
+    size_t out_start = out.size();
+    if (level == 0) {
+        putStored(data + begin, end - begin, out);
+        return;
+    }
+
+    const FixedCodes& codes = fixedCodes();
+    size_t history = min(begin, static_cast<size_t>(windowSize));
+    const unsigned char* window = data + begin - history;
+    int start = static_cast<int>(history);
+    int stop = static_cast<int>(history + end - begin);
+    MatchFinder finder(window, stop, levelParams[level]);
+    for (int pos = 0; pos < start; ++pos) {
+        finder.insert(pos);
+    }
+
+    BitWriter bits(out);
+    auto put_symbol = [&](int symbol) { bits.put(codes.literal[symbol], codes.literalBits[symbol]); };
+    bits.put(0, 1);  // not final
+    bits.put(1, 2);  // fixed Huffman codes
+
+    Match pending;
+    bool has_pending = false;
+    for (int pos = start; pos < stop;) {
+        Match match = has_pending ? pending : finder.find(pos, stop);
+        has_pending = false;
+        finder.insert(pos);
+
+        if (match.length >= minMatch && levelParams[level].lazy && match.length < levelParams[level].nice) {
+            // A longer match at the next byte is worth a literal
+            Match next = finder.find(pos + 1, stop);
+            if (next.length > match.length) {
+                put_symbol(window[pos]);
+                pending = next;
+                has_pending = true;
+                ++pos;
+                continue;
+            }
+        }
+
+        if (match.length >= minMatch) {
+            int code = codes.lengthSymbol[match.length];
+            put_symbol(257 + code);
+            bits.put(match.length - lengthBase[code], lengthExtra[code]);
+            int d = match.distance;
+            code = codes.distanceSymbol[d <= 256 ? d - 1 : 256 + ((d - 1) >> 7)];
+            bits.put(codes.distance[code], 5);
+            bits.put(d - distanceBase[code], distanceExtra[code]);
+            for (int i = 1; i < match.length; ++i) {
+                finder.insert(pos + i);
+            }
+            pos += match.length;
+        } else {
+            put_symbol(window[pos]);
+            ++pos;
+        }
+    }
+    put_symbol(256);
+
+    // Empty stored block, which ends the strip on a byte boundary
+    bits.put(0, 3);
+    bits.align();
+    const unsigned char flush[4] = {0, 0, 0xff, 0xff};
+    out.insert(out.end(), flush, flush + 4);
+
+    // Incompressible strips are stored instead
+    size_t stored_size = end - begin + 5 * ((end - begin + maxStoredBlock - 1) / maxStoredBlock);
+    if (out.size() - out_start > stored_size) {
+        out.resize(out_start);
+        putStored(data + begin, end - begin, out);
+    }
+}
+
+uint32_t adler32(const unsigned char* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        size_t length = min(size, static_cast<size_t>(5552));
+        for (size_t i = 0; i < length; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += length;
+        size -= length;
+    }
+    return b << 16 | a;
+}
+
+// Checksum of two consecutive pieces of data from their own checksums
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t second_size) {
+    const uint32_t base = 65521;
+    uint32_t rem = static_cast<uint32_t>(second_size % base);
+    uint32_t a = first & 0xffff;
+    uint32_t b = static_cast<uint32_t>((static_cast<uint64_t>(rem) * a) % base);
+    a += (second & 0xffff) + base - 1;
+    b += (first >> 16) + (second >> 16) + base - rem;
+    if (a >= base) a -= base;
+    if (a >= base) a -= base;
+    if (b >= 2 * base) b -= 2 * base;
+    if (b >= base) b -= base;
+    return b << 16 | a;
+}
+
+void put32(vector<unsigned char>& out, uint32_t value) {
+    const unsigned char bytes[4] = {static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16),
+                                    static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value)};
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+// Chunks are written as a length placeholder and a tag, then their data, then closed
+size_t beginChunk(vector<unsigned char>& out, const char* tag) {
+    size_t start = out.size();
+    put32(out, 0);
+    out.insert(out.end(), tag, tag + 4);
+    return start;
+}
+
+void endChunk(vector<unsigned char>& out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out.size() - start - 8);
+    for (int i = 0; i < 4; ++i) {
+        out[start + i] = static_cast<unsigned char>(length >> (24 - 8 * i));
+    }
+    put32(out, stbiw__crc32(out.data() + start + 4, static_cast<int>(length + 4)));
+}
+
+// Filter type of each row at low levels, where trying all of them costs more than it saves
+const int fastFilter = 4;  // Paeth
+
+int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// Filter `bytes` bytes of `row` with the filter `type`, `above` being the previous row (zeros for
+// the first one). The pixels left of the row are zeros too.
+void filterLine(const unsigned char* row, const unsigned char* above, int bytes, int channels, int type,
+                signed char* line) {
+    int i = 0;
+    switch (type) {
+        case 0:
+            memcpy(line, row, bytes);
+            break;
+        case 1:
+            for (; i < channels; ++i) {
+                line[i] = static_cast<signed char>(row[i]);
+            }
+            for (; i < bytes; ++i) {
+                line[i] = static_cast<signed char>(row[i] - row[i - channels]);
+            }
+            break;
+        case 2:
+            for (; i < bytes; ++i) {
+                line[i] = static_cast<signed char>(row[i] - above[i]);
+            }
+            break;
+        case 3:
+            for (; i < channels; ++i) {
+                line[i] = static_cast<signed char>(row[i] - (above[i] >> 1));
+            }
+            for (; i < bytes; ++i) {
+                line[i] = static_cast<signed char>(row[i] - ((row[i - channels] + above[i]) >> 1));
+            }
+            break;
+        default:
+            // Paeth of (0, above, 0) is above
+            for (; i < channels; ++i) {
+                line[i] = static_cast<signed char>(row[i] - above[i]);
+            }
+            for (; i < bytes; ++i) {
+                line[i] = static_cast<signed char>(row[i] - paeth(row[i - channels], above[i], above[i - channels]));
+            }
+            break;
+    }
+}
+
+void filterRow(const unsigned char* row, const unsigned char* above, int width, int channels, int level,
+               unsigned char* out, vector<signed char>& line) {
+    int bytes = width * channels;
+    int filter = 0;
+    if (level >= 4) {
+        // Same estimate as stb: the filter with the smallest sum of absolute differences
+        int64_t best_sum = INT64_MAX;
+        for (int type = 0; type < 5; ++type) {
+            filterLine(row, above, bytes, channels, type, line.data());
+            int64_t sum = 0;
+            for (signed char value : line) {
+                sum += abs(value);
+            }
+            if (sum < best_sum) {
+                best_sum = sum;
+                filter = type;
+            }
+        }
+    } else if (level > 0) {
+        filter = fastFilter;
+    }
+    filterLine(row, above, bytes, channels, filter, line.data());
+    out[0] = static_cast<unsigned char>(filter);
+    memcpy(out + 1, line.data(), line.size());
+}
+
+} // namespace
+
+vector<unsigned char> encodePng(const unsigned char* pixels, int width, int height, int channels, size_t stride,
+                                const PngOptions& options) {
+    vector<unsigned char> png;
+    size_t line_bytes = static_cast<size_t>(width) * channels;
+    if (!pixels || width < 1 || height < 1 || channels < 1 || channels > 4 ||
+        line_bytes >= INT_MAX || stride < line_bytes) {
+        return png;
+    }
+    int level = clamp(options.level, 0, 9);
+
+    // Each filtered row starts with its filter type
+    size_t row_bytes = line_bytes + 1;
+    vector<unsigned char> filtered(row_bytes * height);
+    int rows_per_strip = static_cast<int>(max(stripBytes / row_bytes, static_cast<size_t>(1)));
+    int strips = (height - 1) / rows_per_strip + 1;
+
+    auto filter_strips = [&](int first, int last) {
+        vector<signed char> line(line_bytes);
+        // The first row is filtered against a row of zeros
+        vector<unsigned char> zeros(first == 0 ? line_bytes : 0);
+        for (int y = first * rows_per_strip; y < min(last * rows_per_strip, height); ++y) {
+            // Rows may be further apart than an int, their offsets are computed in size_t
+            const unsigned char* row = pixels + static_cast<size_t>(y) * stride;
+            const unsigned char* above = y > 0 ? row - stride : zeros.data();
+            filterRow(row, above, width, channels, level, &filtered[y * row_bytes], line);
+        }
+    };
+
+    // Each strip becomes one IDAT chunk of the zlib stream, the first one starts with its header
+    vector<vector<unsigned char>> chunks(strips);
+    vector<uint32_t> checksums(strips);
+    auto compress_strips = [&](int first, int last) {
+        for (int strip = first; strip < last; ++strip) {
+            size_t begin = static_cast<size_t>(strip) * rows_per_strip * row_bytes;
+            size_t end = min(static_cast<size_t>(strip + 1) * rows_per_strip, static_cast<size_t>(height)) * row_bytes;
+            vector<unsigned char>& chunk = chunks[strip];
+            size_t start = beginChunk(chunk, "IDAT");
+            if (strip == 0) {
+                const unsigned char flags[10] = {0x01, 0x01, 0x5e, 0x5e, 0x5e, 0x5e, 0x9c, 0xda, 0xda, 0xda};
+                chunk.push_back(0x78);  // deflate, 32K window
+                chunk.push_back(flags[level]);
+            }
+            deflateStrip(filtered.data(), begin, end, level, chunk);
+            endChunk(chunk, start);
+            checksums[strip] = adler32(filtered.data() + begin, end - begin);
+        }
+    };
+
+    if (options.parallel && strips > 1) {
+        // Compressing a strip reads the end of the previous one, every strip is filtered first
+        Scheduler& scheduler = Scheduler::shared();
+        scheduler.parallelFor(0, strips, 1, filter_strips);
+        scheduler.parallelFor(0, strips, 1, compress_strips);
+    } else {
+        filter_strips(0, strips);
+        compress_strips(0, strips);
+    }
+
+    const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    png.insert(png.end(), signature, signature + 8);
+
+    const int color_types[5] = {-1, 0, 4, 2, 6};
+    size_t start = beginChunk(png, "IHDR");
+    put32(png, width);
+    put32(png, height);
+    const unsigned char format[5] = {8, static_cast<unsigned char>(color_types[channels]), 0, 0, 0};
+    png.insert(png.end(), format, format + 5);
+    endChunk(png, start);
+
+    uint32_t checksum = checksums[0];
+    for (int strip = 0; strip < strips; ++strip) {
+        png.insert(png.end(), chunks[strip].begin(), chunks[strip].end());
+        if (strip > 0) {
+            size_t size = (min((strip + 1) * rows_per_strip, height) - strip * rows_per_strip) * row_bytes;
+            checksum = adler32Combine(checksum, checksums[strip], size);
+        }
+        vector<unsigned char>().swap(chunks[strip]);
+    }
+
+    // Empty final block with fixed codes, then the checksum of the whole filtered data
+    start = beginChunk(png, "IDAT");
+    png.push_back(0x03);
+    png.push_back(0x00);
+    put32(png, checksum);
+    endChunk(png, start);
+
+    start = beginChunk(png, "IEND");
+    endChunk(png, start);
+    return png;
+}
+
+bool writePng(const string& filename, const unsigned char* pixels, int width, int height, int channels, size_t stride,
+              const PngOptions& options) {
+    vector<unsigned char> png = encodePng(pixels, width, height, channels, stride, options);
+    if (png.empty()) {
+        return false;
+    }
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    return fclose(file) == 0 && ok;
+}
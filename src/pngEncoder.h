@@ -0,0 +1,24 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct PngOptions {
+    // Compression level: 0 stores the data uncompressed (temporary files), 1 is the fastest,
+    // 9 the smallest. Levels up to 3 use a single filter instead of trying all five per row.
+    int level = 6;
+    // Filter and compress strips of rows as tasks of the shared scheduler. Every strip is its own
+    // run of deflate blocks, matches still reach back into the previous strip.
+    bool parallel = false;
+};
+
+// PNG of 8-bit pixels with `channels` interleaved components (1 gray, 2 gray and alpha, 3 RGB,
+// 4 RGBA), rows `stride` bytes apart. Empty if the image is empty or too large.
+std::vector<unsigned char> encodePng(const unsigned char* pixels, int width, int height, int channels,
+                                     size_t stride, const PngOptions& options = PngOptions());
+bool writePng(const std::string& filename, const unsigned char* pixels, int width, int height, int channels,
+              size_t stride, const PngOptions& options = PngOptions());
+
+#endif // PNGENCODER_H
@@ -0,0 +1,288 @@
+#include "qoiCodec.h"
+
+#include <climits>
+#include <cstring>
+
+using namespace std;
+
+static const unsigned char qoiMagic[4] = {'q', 'o', 'i', 'f'};
+static const unsigned char qoiEnd[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+static const size_t qoiBufferBytes = 1 << 16;
+static const int qoiMaxRun = 62;
+
+// Operations, the 2-bit ones are told apart by their top bits
+enum : unsigned char {
+    QoiIndex = 0x00,
+    QoiDiff = 0x40,
+    QoiLuma = 0x80,
+    QoiRun = 0xc0,
+    QoiRgb = 0xfe,
+    QoiRgba = 0xff
+};
+
+// Pixels are handled as r | g << 8 | b << 16 | a << 24
+static uint32_t packPixel(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    return r | static_cast<uint32_t>(g) << 8 | static_cast<uint32_t>(b) << 16 | static_cast<uint32_t>(a) << 24;
+}
+
+static unsigned char channel(uint32_t pixel, int i) {
+    return static_cast<unsigned char>(pixel >> (8 * i));
+}
+
+static int hashPixel(uint32_t pixel) {
+    return (channel(pixel, 0) * 3 + channel(pixel, 1) * 5 + channel(pixel, 2) * 7 + channel(pixel, 3) * 11) & 63;
+}
+
+QoiWriter::~QoiWriter() {
+    close();
+}
+
+bool QoiWriter::open(const string& filename, int width, int height) {
+    close();
+    if (width < 1 || height < 1) {
+        return false;
+    }
+    m_file = fopen(filename.c_str(), "wb");
+    if (!m_file) {
+        return false;
+    }
+    m_buffer.resize(qoiBufferBytes);
+    m_used = 0;
+    m_failed = false;
+    m_width = width;
+    m_rowsLeft = height;
+    memset(m_index, 0, sizeof(m_index));
+    m_previous = packPixel(0, 0, 0, 255);
+    m_run = 0;
+
+    for (unsigned char byte : qoiMagic) {
+        put(byte);
+    }
+    for (uint32_t size : {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            put(static_cast<unsigned char>(size >> shift));
+        }
+    }
+    put(4);  // RGBA
+    put(0);  // sRGB with linear alpha
+    return true;
+}
+
+bool QoiWriter::writeRow(const unsigned char* rgba) {
+    if (!m_file || m_rowsLeft == 0) {
+        return false;
+    }
+    for (int x = 0; x < m_width; ++x, rgba += 4) {
+        uint32_t pixel = packPixel(rgba[0], rgba[1], rgba[2], rgba[3]);
+        if (pixel == m_previous) {
+            // Runs continue from one row to the next
+            if (++m_run == qoiMaxRun) {
+                putRun();
+            }
+            continue;
+        }
+        putRun();
+
+        int hash = hashPixel(pixel);
+        if (m_index[hash] == pixel) {
+            put(QoiIndex | hash);
+        } else {
+            m_index[hash] = pixel;
+            if (channel(pixel, 3) == channel(m_previous, 3)) {
+                int dr = static_cast<signed char>(rgba[0] - channel(m_previous, 0));
+                int dg = static_cast<signed char>(rgba[1] - channel(m_previous, 1));
+                int db = static_cast<signed char>(rgba[2] - channel(m_previous, 2));
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    put(QoiDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    put(QoiLuma | (dg + 32));
+                    put((dr_dg + 8) << 4 | (db_dg + 8));
+                } else {
+                    put(QoiRgb);
+                    put(rgba[0]);
+                    put(rgba[1]);
+                    put(rgba[2]);
+                }
+            } else {
+                put(QoiRgba);
+                put(rgba[0]);
+                put(rgba[1]);
+                put(rgba[2]);
+                put(rgba[3]);
+            }
+        }
+        m_previous = pixel;
+    }
+    --m_rowsLeft;
+    return !m_failed;
+}
+
+bool QoiWriter::close() {
+    if (!m_file) {
+        return true;
+    }
+    putRun();
+    for (unsigned char byte : qoiEnd) {
+        put(byte);
+    }
+    flush();
+    bool ok = !m_failed && m_rowsLeft == 0;
+    ok = fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+    vector<unsigned char>().swap(m_buffer);
+    return ok;
+}
+
+void QoiWriter::putRun() {
+    if (m_run > 0) {
+        put(QoiRun | (m_run - 1));
+        m_run = 0;
+    }
+}
+
+void QoiWriter::flush() {
+    if (m_used > 0 && fwrite(m_buffer.data(), 1, m_used, m_file) != m_used) {
+        m_failed = true;
+    }
+    m_used = 0;
+}
+
+QoiReader::~QoiReader() {
+    close();
+}
+
+bool QoiReader::open(const string& filename) {
+    close();
+    m_file = fopen(filename.c_str(), "rb");
+    if (!m_file) {
+        return false;
+    }
+    m_buffer.resize(qoiBufferBytes);
+    m_position = 0;
+    m_available = 0;
+    m_failed = false;
+    memset(m_index, 0, sizeof(m_index));
+    m_previous = packPixel(0, 0, 0, 255);
+    m_run = 0;
+
+    unsigned char header[14];
+    for (unsigned char& byte : header) {
+        byte = get();
+    }
+    uint32_t width = 0, height = 0;
+    for (int i = 0; i < 4; ++i) {
+        width = width << 8 | header[4 + i];
+        height = height << 8 | header[8 + i];
+    }
+    // Three channel files decode with an opaque alpha
+    if (m_failed || memcmp(header, qoiMagic, sizeof(qoiMagic)) != 0 || width == 0 || height == 0 ||
+        width > INT_MAX || height > INT_MAX || (header[12] != 3 && header[12] != 4) || header[13] > 1) {
+        close();
+        return false;
+    }
+    m_width = static_cast<int>(width);
+    m_height = static_cast<int>(height);
+    m_rowsLeft = m_height;
+    return true;
+}
+
+bool QoiReader::readRow(unsigned char* rgba) {
+    if (!m_file || m_failed || m_rowsLeft == 0) {
+        return false;
+    }
+    uint32_t pixel = m_previous;
+    for (int x = 0; x < m_width; ++x, rgba += 4) {
+        if (m_run > 0) {
+            --m_run;
+        } else {
+            unsigned char r = channel(pixel, 0), g = channel(pixel, 1), b = channel(pixel, 2), a = channel(pixel, 3);
+            unsigned char op = get();
+            if (op == QoiRgb) {
+                r = get();
+                g = get();
+                b = get();
+            } else if (op == QoiRgba) {
+                r = get();
+                g = get();
+                b = get();
+                a = get();
+            } else if ((op & 0xc0) == QoiIndex) {
+                uint32_t indexed = m_index[op];
+                r = channel(indexed, 0);
+                g = channel(indexed, 1);
+                b = channel(indexed, 2);
+                a = channel(indexed, 3);
+            } else if ((op & 0xc0) == QoiDiff) {
+                r += ((op >> 4) & 3) - 2;
+                g += ((op >> 2) & 3) - 2;
+                b += (op & 3) - 2;
+            } else if ((op & 0xc0) == QoiLuma) {
+                unsigned char next = get();
+                int dg = (op & 0x3f) - 32;
+                r += dg - 8 + (next >> 4);
+                g += dg;
+                b += dg - 8 + (next & 0x0f);
+            } else {
+                // This pixel is the first of the run
+                m_run = op & 0x3f;
+            }
+            pixel = packPixel(r, g, b, a);
+            m_index[hashPixel(pixel)] = pixel;
+        }
+        rgba[0] = channel(pixel, 0);
+        rgba[1] = channel(pixel, 1);
+        rgba[2] = channel(pixel, 2);
+        rgba[3] = channel(pixel, 3);
+    }
+    m_previous = pixel;
+    --m_rowsLeft;
+    return !m_failed;
+}
+
+void QoiReader::close() {
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+    vector<unsigned char>().swap(m_buffer);
+}
+
+bool QoiReader::fill() {
+    if (!m_file) {
+        return false;
+    }
+    m_available = fread(m_buffer.data(), 1, m_buffer.size(), m_file);
+    m_position = 0;
+    return m_available > 0;
+}
+
+bool writeQoi(const string& filename, const unsigned char* rgba, int width, int height, size_t stride) {
+    QoiWriter writer;
+    if (!writer.open(filename, width, height)) {
+        return false;
+    }
+    for (int y = 0; y < height; ++y) {
+        if (!writer.writeRow(rgba + y * stride)) {
+            return false;
+        }
+    }
+    return writer.close();
+}
+
+bool readQoiSize(const string& filename, int& width, int& height) {
+    QoiReader reader;
+    if (!reader.open(filename)) {
+        return false;
+    }
+    width = reader.width();
+    height = reader.height();
+    return true;
+}
+
+bool hasQoiExtension(const string& filename) {
+    const string extension = ".qoi";
+    return filename.size() >= extension.size() &&
+           filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
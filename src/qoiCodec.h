@@ -0,0 +1,97 @@
+#ifndef QOICODEC_H
+#define QOICODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// QOI ("Quite OK Image") files: lossless, about as small as a fast PNG and an order of magnitude
+// faster to encode and decode, meant for scratch and cache files. Both ends stream one row of
+// RGBA pixels at a time through a small file buffer, so no full-size copy of the image is made.
+
+// Writes the rows of an image from top to bottom, the file is complete once close() succeeds
+class QoiWriter {
+public:
+    QoiWriter() = default;
+    ~QoiWriter();
+    QoiWriter(const QoiWriter&) = delete;
+    QoiWriter& operator=(const QoiWriter&) = delete;
+
+    bool open(const std::string& filename, int width, int height);
+    // `width` RGBA pixels
+    bool writeRow(const unsigned char* rgba);
+    // Write the end of the stream and close the file, false if any write failed
+    bool close();
+
+private:
+    void put(unsigned char byte) {
+        if (m_used == m_buffer.size()) {
+            flush();
+        }
+        m_buffer[m_used++] = byte;
+    }
+    void putRun();
+    void flush();
+
+    FILE* m_file = nullptr;
+    std::vector<unsigned char> m_buffer;
+    size_t m_used = 0;
+    bool m_failed = false;
+    int m_width = 0;
+    int m_rowsLeft = 0;
+    uint32_t m_index[64] = {};
+    uint32_t m_previous = 0;
+    int m_run = 0;
+};
+
+// Reads the rows of an image from top to bottom
+class QoiReader {
+public:
+    QoiReader() = default;
+    ~QoiReader();
+    QoiReader(const QoiReader&) = delete;
+    QoiReader& operator=(const QoiReader&) = delete;
+
+    // Open the file and read its header, false if it is not a QOI file
+    bool open(const std::string& filename);
+    // Decode the next `width` RGBA pixels, false if the file is truncated or corrupt
+    bool readRow(unsigned char* rgba);
+    void close();
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+private:
+    // Next byte of the file, 0 past its end which marks the reader as failed
+    unsigned char get() {
+        if (m_position == m_available && !fill()) {
+            m_failed = true;
+            return 0;
+        }
+        return m_buffer[m_position++];
+    }
+    bool fill();
+
+    FILE* m_file = nullptr;
+    std::vector<unsigned char> m_buffer;
+    size_t m_position = 0;
+    size_t m_available = 0;
+    bool m_failed = false;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rowsLeft = 0;
+    uint32_t m_index[64] = {};
+    uint32_t m_previous = 0;
+    int m_run = 0;
+};
+
+// Whole image from rows `stride` bytes apart
+bool writeQoi(const std::string& filename, const unsigned char* rgba, int width, int height, size_t stride);
+// Size of the image in a QOI file without decoding it
+bool readQoiSize(const std::string& filename, int& width, int& height);
+
+bool hasQoiExtension(const std::string& filename);
+
+#endif // QOICODEC_H
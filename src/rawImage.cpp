@@ -0,0 +1,59 @@
+#include "rawImage.h"
+#include "mappedFile.h"
+
+#include <climits>
+#include <cstring>
+
+using namespace std;
+
+// Whether `rows` rows of `row_bytes` bytes from `offset` end within `size` bytes, without any
+// product or sum that could wrap around
+static bool sectionFits(uint64_t offset, uint64_t rows, uint64_t row_bytes, uint64_t size) {
+    if (offset > size) {
+        return false;
+    }
+    return row_bytes == 0 || rows <= (size - offset) / row_bytes;
+}
+
+bool readRawImageHeader(const MappedFile& file, RawImageHeader& header) {
+    if (!file.isOpen() || file.size() < sizeof(RawImageHeader)) {
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(RawImageHeader));
+    if (memcmp(header.magic, rawImageMagic, sizeof(rawImageMagic)) != 0 ||
+        header.version != rawImageVersion || header.headerSize < sizeof(RawImageHeader)) {
+        return false;
+    }
+
+    // Rows are indexed with int, and every section must fit in the file
+    if (header.stride > INT_MAX || header.height > INT_MAX || header.seamMapWidth > INT_MAX ||
+        header.stride < static_cast<uint64_t>(header.padding) + header.width) {
+        return false;
+    }
+    uint64_t rows = header.height;
+    uint64_t size = file.size();
+    if (!sectionFits(header.pixelOffset, rows, static_cast<uint64_t>(header.stride) * 4, size)) {
+        return false;
+    }
+    if (header.energyOffset != 0 &&
+        !sectionFits(header.energyOffset, rows, static_cast<uint64_t>(header.stride) * sizeof(double), size)) {
+        return false;
+    }
+    if (header.seamMapWidth != 0 &&
+        !sectionFits(header.seamMapOffset, rows, static_cast<uint64_t>(header.seamMapWidth) * sizeof(int32_t), size)) {
+        return false;
+    }
+    return true;
+}
+
+uint32_t rawEnergyKind(const Settings& settings) {
+    return static_cast<uint32_t>(settings.energyMetric) |
+           (settings.alphaInEnergy ? 1u : 0u) << 8 |
+           static_cast<uint32_t>(settings.costType) << 16;
+}
+
+bool hasRawImageExtension(const string& filename) {
+    const string extension = ".scraw";
+    return filename.size() >= extension.size() &&
+           filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
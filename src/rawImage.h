@@ -0,0 +1,52 @@
+#ifndef RAWIMAGE_H
+#define RAWIMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "settings.h"
+
+class MappedFile;
+
+// Raw image format (.scraw) passing images between tools without any codec. Fields are in the
+// byte order of the machine, little-endian on every supported target. The file holds:
+//   header    RawImageHeader
+//   pixels    height rows of `stride` RGBA pixels, row y at pixelOffset + y * stride * 4 bytes.
+//             The image starts `padding` pixels into each row, which leaves room for the borders
+//             SeamCarving needs: such an input is carved straight from its (private) mapping.
+//   energy    optional, height rows of `stride` doubles, pixel x of row y at index y * stride + x
+//   seam map  optional, height rows of seamMapWidth int32: for each pixel of the image before
+//             carving, the index of the seam that removed it, or -1 if it was kept
+// Every section starts on a multiple of rawImageAlignment bytes, and so does every pixel row.
+struct RawImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // later versions only append fields
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;            // pixels per row, padding included
+    uint32_t padding;           // pixels before the first one of each row
+    uint64_t pixelOffset;
+    uint64_t energyOffset;      // 0 without energy
+    uint32_t energyKind;        // settings the energy was computed with, see rawEnergyKind()
+    uint32_t seamMapWidth;      // 0 without seam map
+    uint64_t seamMapOffset;
+};
+
+static_assert(sizeof(RawImageHeader) == 64, "RawImageHeader must keep its on-disk size");
+
+constexpr char rawImageMagic[8] = {'S', 'C', 'R', 'A', 'W', '\r', '\n', '\x1a'};
+constexpr uint32_t rawImageVersion = 1;
+constexpr size_t rawImageAlignment = 64;
+
+// Header of a mapped .scraw file, false if the file is not one or its sections do not fit in it
+bool readRawImageHeader(const MappedFile& file, RawImageHeader& header);
+
+// Identifies the energy computed with the given settings, a stored energy is only reused by
+// a SeamCarving with the same one
+uint32_t rawEnergyKind(const Settings& settings);
+
+bool hasRawImageExtension(const std::string& filename);
+
+#endif // RAWIMAGE_H
@@ -0,0 +1,171 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// Pool and queue of the current thread, queue 0 outside of any pool
+static thread_local const Scheduler* t_scheduler = nullptr;
+static thread_local int t_queue = 0;
+
+static int defaultThreadCount() {
+    const char* forced = getenv("SEAMCARVING_THREADS");
+    if (forced && atoi(forced) > 0) {
+        return atoi(forced);
+    }
+    return max(static_cast<int>(thread::hardware_concurrency()), 1);
+}
+
+Scheduler& Scheduler::shared() {
+    static Scheduler scheduler(defaultThreadCount());
+    return scheduler;
+}
+
+Scheduler::Scheduler(int threads) : m_queued(0), m_stop(false) {
+    threads = max(threads, 1);
+    for (int i = 0; i < threads; ++i) {
+        m_queues.push_back(make_unique<Queue>());
+    }
+    for (int i = 1; i < threads; ++i) {
+        m_workers.emplace_back(&Scheduler::workerLoop, this, i);
+    }
+}
+
+Scheduler::~Scheduler() {
+    {
+        lock_guard<mutex> lock(m_sleepLock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+int Scheduler::threadCount() const {
+    return static_cast<int>(m_queues.size());
+}
+
+void Scheduler::push(function<void()> task) {
+    Queue& queue = *m_queues[t_scheduler == this ? t_queue : 0];
+    {
+        lock_guard<mutex> lock(queue.lock);
+        queue.tasks.push_back(move(task));
+    }
+    ++m_queued;
+
+    // Taking the lock orders the notification after the check of a worker going to sleep
+    { lock_guard<mutex> lock(m_sleepLock); }
+    m_wake.notify_one();
+}
+
+bool Scheduler::runOne() {
+    function<void()> task;
+    int own = t_scheduler == this ? t_queue : -1;
+
+    // Most recent task of our own queue first, it is the most likely to be in cache
+    if (own > 0) {
+        Queue& queue = *m_queues[own];
+        lock_guard<mutex> lock(queue.lock);
+        if (!queue.tasks.empty()) {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+
+    // Otherwise steal the oldest task of another queue, which is usually the largest
+    int count = static_cast<int>(m_queues.size());
+    for (int i = 1; !task && i <= count; ++i) {
+        Queue& queue = *m_queues[(max(own, 0) + i) % count];
+        lock_guard<mutex> lock(queue.lock);
+        if (!queue.tasks.empty()) {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+    --m_queued;
+    task();
+    return true;
+}
+
+void Scheduler::workerLoop(int index) {
+    t_scheduler = this;
+    t_queue = index;
+    while (true) {
+        if (runOne()) {
+            continue;
+        }
+        unique_lock<mutex> lock(m_sleepLock);
+        m_wake.wait(lock, [&] { return m_stop || m_queued > 0; });
+        if (m_stop && m_queued == 0) {
+            return;
+        }
+    }
+}
+
+void Scheduler::parallelFor(int begin, int end, int grain, const function<void(int, int)>& body) {
+    grain = max(grain, 1);
+    if (end - begin <= grain) {
+        if (begin < end) {
+            body(begin, end);
+        }
+        return;
+    }
+
+    // Hand the upper half over to a thief and keep splitting the lower one
+    int middle = begin + (end - begin) / 2;
+    TaskGroup group(*this);
+    group.run([=, &body] { parallelFor(middle, end, grain, body); });
+    parallelFor(begin, middle, grain, body);
+    group.wait();
+}
+
+void Scheduler::waitUntil(const function<bool()>& ready) {
+    while (!ready()) {
+        if (!runOne()) {
+            this_thread::yield();
+        }
+    }
+}
+
+TaskGroup::TaskGroup(Scheduler& scheduler) : m_scheduler(scheduler), m_pending(0) {}
+
+TaskGroup::~TaskGroup() {
+    m_scheduler.waitUntil([&] { return m_pending == 0; });
+}
+
+void TaskGroup::run(function<void()> task) {
+    ++m_pending;
+    m_scheduler.push([this, task = move(task)]() mutable {
+        try {
+            task();
+        } catch (...) {
+            lock_guard<mutex> lock(m_errorLock);
+            if (!m_error) {
+                m_error = current_exception();
+            }
+        }
+        // The captures of the task may refer to the waiter's stack: they are destroyed before
+        // wait() can return
+        task = nullptr;
+        --m_pending;
+    });
+}
+
+void TaskGroup::wait() {
+    m_scheduler.waitUntil([&] { return m_pending == 0; });
+
+    exception_ptr error;
+    {
+        lock_guard<mutex> lock(m_errorLock);
+        swap(error, m_error);
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
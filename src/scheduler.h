@@ -0,0 +1,81 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Work-stealing pool of threads shared by every parallel phase: energy, seam search and batch jobs.
+// Each worker pops the tasks it spawned from the back of its own queue and steals from the
+// front of the others' when it runs out. Threads waiting on a TaskGroup run tasks meanwhile,
+// so nested parallel work never blocks a worker.
+class Scheduler {
+public:
+    // Pool used by the library. Its size is the number of hardware threads, or the
+    // SEAMCARVING_THREADS environment variable.
+    static Scheduler& shared();
+
+    // `threads` counts the thread calling wait(): threads - 1 workers are started
+    explicit Scheduler(int threads);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    int threadCount() const;
+
+    // Call body(first, last) on subranges of [begin, end) of at most `grain` elements, in parallel
+    void parallelFor(int begin, int end, int grain, const function<void(int, int)>& body);
+
+    // Run queued tasks until ready() returns true
+    void waitUntil(const function<bool()>& ready);
+
+private:
+    friend class TaskGroup;
+
+    struct Queue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    void push(function<void()> task);
+    // Run one queued task, false if there was none
+    bool runOne();
+    void workerLoop(int index);
+
+    // Queue 0 receives the tasks of threads outside of the pool, queue i those of worker i
+    vector<unique_ptr<Queue>> m_queues;
+    vector<thread> m_workers;
+    atomic<int> m_queued;
+    bool m_stop;
+    mutex m_sleepLock;
+    condition_variable m_wake;
+};
+
+// Tasks whose completion can be waited for together
+class TaskGroup {
+public:
+    explicit TaskGroup(Scheduler& scheduler = Scheduler::shared());
+    ~TaskGroup();
+
+    void run(function<void()> task);
+    // Run queued tasks until every task of the group is done, then rethrow the first
+    // exception thrown by one of them
+    void wait();
+
+private:
+    Scheduler& m_scheduler;
+    atomic<int> m_pending;
+    mutex m_errorLock;
+    exception_ptr m_error;
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,54 @@
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+// Bump allocator handing out temporary buffers from one block allocated up front.
+// Buffers stay valid until the next reset(), which makes the whole block available again.
+class ScratchArena {
+public:
+    static constexpr size_t alignment = 64;
+
+    // Bytes to reserve so that a buffer of n elements of T always fits, padding included
+    template <typename T>
+    static size_t bytesFor(size_t n) {
+        return n * sizeof(T) + alignment;
+    }
+
+    void reserve(size_t bytes) {
+        m_block.reset(new unsigned char[bytes + alignment]);
+        uintptr_t base = reinterpret_cast<uintptr_t>(m_block.get());
+        m_begin = m_block.get() + (alignment - base % alignment) % alignment;
+        m_capacity = bytes;
+        m_used = 0;
+    }
+
+    void reset() {
+        m_used = 0;
+    }
+
+    template <typename T>
+    T* take(size_t n) {
+        size_t start = (m_used + alignment - 1) / alignment * alignment;
+        if (start + n * sizeof(T) > m_capacity) {
+            throw std::length_error("ScratchArena: out of reserved memory");
+        }
+        m_used = start + n * sizeof(T);
+        return reinterpret_cast<T*>(m_begin + start);
+    }
+
+    size_t capacity() const {
+        return m_capacity;
+    }
+
+private:
+    std::unique_ptr<unsigned char[]> m_block;
+    unsigned char* m_begin = nullptr;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+};
+
+#endif // SCRATCHARENA_H
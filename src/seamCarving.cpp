@@ -1,295 +1,813 @@
 #include "seamCarving.h"
+#include "seamEngine.h"
+#include "rawImage.h"
+#include "pngEncoder.h"
+#include "qoiCodec.h"
+#include "energyKernels.h"
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
+#define STB_IMAGE_IMPLEMENTATION
 #include "../libs/stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "../libs/stb_image_write.h"
 
 using namespace std;
 
 // Constructor
 SeamCarving::SeamCarving(const string& filename, Settings s) {
     settings = s;
-    int channels = 4;
+    if (loadRawImage(filename)) {
+        loadRawEnergy();
+        return;
+    }
+    if (!loadQoiImage(filename)) {
+        decodeImage(filename);
+    }
+}
 
-    // Load image data
-    auto data = stbi_load(filename.c_str(), &m_width, &m_height, NULL, channels);
-    if (!data) {
-        cerr << "Couldn't load file " << filename << endl;
-    }
-
-    // Convert loaded image data into list of Pixel for further processing
-    m_data = vector(m_height, list<Pixel>());
-    for (int x = 0; x < m_height; x++) {
-        for (int y = 0; y < m_width; y++) {
-            Pixel p;
-            int idx = (m_width * x + y) * 4;
-            p.r = data[idx];
-            p.g = data[idx + 1];
-            p.b = data[idx + 2];
-            p.a = data[idx + 3];
-            m_data[x].push_back(p);
+SeamCarving::SeamCarving(const ImageView& view, Settings s) {
+    settings = s;
+    copyFromView(view);
+}
+
+SeamCarving::SeamCarving(PixelBuffer&& pixels, Settings s) {
+    settings = s;
+    if (pixels.width < 0 || pixels.height < 0 || pixels.width > maxImageSize || pixels.height > maxImageSize ||
+        pixels.stride < pixels.width + 2 * SeamContext::border ||
+        pixels.pixels.size() < static_cast<size_t>(pixels.stride) * pixels.height) {
+        throw invalid_argument("PixelBuffer too small for its size and borders");
+    }
+    m_width = pixels.width;
+    m_height = pixels.height;
+    m_stride = pixels.stride;
+    m_ownedPixels = move(pixels.pixels);
+    m_data = m_ownedPixels.data();
+    pixels = PixelBuffer();
+    prepare();
+}
+
+void SeamCarving::copyFromView(const ImageView& view) {
+    if (view.width < 0 || view.height < 0 || view.width > maxImageSize || view.height > maxImageSize) {
+        throw invalid_argument("ImageView larger than maxImageSize");
+    }
+    m_width = view.width;
+    m_height = view.height;
+    allocatePixels();
+    setupBuffers();
+    SeamContext ctx = context();
+    for (int y = 0; y < m_height; ++y) {
+        const unsigned char* src = view.data + y * view.stride;
+        Pixel* row = &m_data[static_cast<size_t>(y) * m_stride + SeamContext::border];
+        switch (view.format) {
+            case PixelFormat::RGBA:
+                memcpy(row, src, static_cast<size_t>(m_width) * sizeof(Pixel));
+                break;
+            case PixelFormat::BGRA:
+                for (int x = 0; x < m_width; ++x, src += 4) {
+                    row[x] = Pixel{src[2], src[1], src[0], src[3]};
+                }
+                break;
+            case PixelFormat::RGB:
+                for (int x = 0; x < m_width; ++x, src += 3) {
+                    row[x] = Pixel{src[0], src[1], src[2], 255};
+                }
+                break;
+            case PixelFormat::Gray:
+                for (int x = 0; x < m_width; ++x) {
+                    row[x] = Pixel{src[x], src[x], src[x], 255};
+                }
+                break;
         }
+        rowLoaded(ctx, y);
     }
 }
 
-// Getter functions
-vector<list<Pixel>> SeamCarving::getCarvedData() const {
-    return m_data;
+void SeamCarving::decodeImage(const string& filename) {
+    int width = 0;
+    int height = 0;
+    unsigned char* data = stbi_load(filename.c_str(), &width, &height, NULL, 4);
+    if (!data) {
+        cerr << "Couldn't load file " << filename << ": " << stbi_failure_reason() << endl;
+        copyFromView(ImageView{nullptr, 0, 0, 0, PixelFormat::RGBA});
+        return;
+    }
+    if (settings.outOfCore) {
+        // The rows go to their temporary file, the decoded image is released at once
+        copyFromView(ImageView{data, width, height, static_cast<size_t>(width) * sizeof(Pixel), PixelFormat::RGBA});
+        stbi_image_free(data);
+        return;
+    }
+
+    // stb decodes whole images into a buffer of its own: rather than copying it, grow it to the
+    // padded size (large blocks are remapped, not copied) and spread the rows in place. Going
+    // from the last row up, no row overwrites one that has not moved yet.
+    int stride = width + 2 * SeamContext::border;
+    size_t row_bytes = static_cast<size_t>(width) * sizeof(Pixel);
+    auto padded = static_cast<unsigned char*>(realloc(data, static_cast<size_t>(stride) * height * sizeof(Pixel)));
+    if (!padded) {
+        copyFromView(ImageView{data, width, height, row_bytes, PixelFormat::RGBA});
+        stbi_image_free(data);
+        return;
+    }
+    m_decodedPixels.reset(padded);
+    for (int y = height - 1; y >= 0; --y) {
+        memmove(padded + (static_cast<size_t>(y) * stride + SeamContext::border) * sizeof(Pixel),
+                padded + y * row_bytes, row_bytes);
+    }
+
+    m_width = width;
+    m_height = height;
+    m_stride = stride;
+    m_data = reinterpret_cast<Pixel*>(padded);
+    if (settings.seamThreads > 1) {
+        // Every row is already there, the tasks share the energy of the whole image
+        prepare();
+        m_engine->computeEnergy(context());
+        m_energyValid = true;
+        return;
+    }
+    setupBuffers();
+    SeamContext ctx = context();
+    for (int y = 0; y < m_height; ++y) {
+        rowLoaded(ctx, y);
+    }
 }
 
-int SeamCarving::getCarvedWidth() const {
-    return m_width;
+bool SeamCarving::loadRawImage(const string& filename) {
+    MappedFile file;
+    RawImageHeader header;
+    if (!file.open(filename, MappedFile::Mode::Private) || !readRawImageHeader(file, header)) {
+        return false;
+    }
+
+    if (header.width > maxImageSize || header.height > maxImageSize) {
+        cerr << "Couldn't load file " << filename << ": image too large" << endl;
+        copyFromView(ImageView{nullptr, 0, 0, 0, PixelFormat::RGBA});
+        return true;
+    }
+
+    const unsigned char* pixels = file.data() + header.pixelOffset;
+    int right_padding = header.stride - header.padding - header.width;
+    // Out of core the pixels are copied into a temporary file instead: the carving touches every
+    // row, which would end up copied in memory
+    if (header.padding >= SeamContext::border && right_padding >= SeamContext::border && !settings.outOfCore) {
+        // Copy-on-write mapping: only the pages of the rows touched by the carving get copied
+        m_width = header.width;
+        m_height = header.height;
+        m_stride = header.stride;
+        m_data = reinterpret_cast<Pixel*>(file.data() + header.pixelOffset) + header.padding - SeamContext::border;
+        prepare();
+    } else {
+        copyFromView(ImageView{pixels + header.padding * 4, static_cast<int>(header.width), static_cast<int>(header.height),
+                               static_cast<size_t>(header.stride) * 4, PixelFormat::RGBA});
+    }
+    m_mappedPixels = move(file);
+    return true;
 }
 
-int SeamCarving::getCarvedHeight() const {
-    return m_height;
+bool SeamCarving::loadQoiImage(const string& filename) {
+    QoiReader reader;
+    if (!reader.open(filename)) {
+        return false;
+    }
+    if (reader.width() > maxImageSize || reader.height() > maxImageSize) {
+        cerr << "Couldn't load file " << filename << ": image too large" << endl;
+        copyFromView(ImageView{nullptr, 0, 0, 0, PixelFormat::RGBA});
+        return true;
+    }
+    m_width = reader.width();
+    m_height = reader.height();
+    allocatePixels();
+    setupBuffers();
+    SeamContext ctx = context();
+    bool complete = true;
+    for (int y = 0; y < m_height; ++y) {
+        Pixel* row = &m_data[static_cast<size_t>(y) * m_stride + SeamContext::border];
+        if (complete && !reader.readRow(reinterpret_cast<unsigned char*>(row))) {
+            // The rows that could not be decoded are left transparent black
+            cerr << "Couldn't load file " << filename << " past row " << y << endl;
+            complete = false;
+        }
+        rowLoaded(ctx, y);
+    }
+    return true;
 }
 
-// Main carve function
-void SeamCarving::carve(int num_seams) {
-    computeEnergy();
-    for (int i = 0; i < num_seams; ++i) {
-        if (settings.doBackwardSearch) {
-            auto seam = findBackwardSeam();
-            removeSeam(seam);
+void SeamCarving::loadRawEnergy() {
+    // Images too large to load have no mapping left
+    RawImageHeader header = {};
+    if (!readRawImageHeader(m_mappedPixels, header)) {
+        return;
+    }
+    if (header.energyOffset != 0 && header.energyKind == rawEnergyKind(settings)) {
+        // Converted back to the cost type with the same scale, the values are exactly those computed
+        // Rows of the file are header.stride apart, which differs from m_stride if the pixels were copied
+        for (int y = 0; y < m_height; ++y) {
+            const double* energy = reinterpret_cast<const double*>(m_mappedPixels.data() + header.energyOffset) +
+                                   static_cast<size_t>(y) * header.stride;
+            size_t row = static_cast<size_t>(y) * m_stride;
+            switch (settings.costType) {
+                case CostType::Float:
+                    copy(energy, energy + m_width, static_cast<float*>(energyData()) + row);
+                    break;
+                case CostType::Fixed: {
+                    uint32_t* fixed = static_cast<uint32_t*>(energyData()) + row;
+                    for (int x = 0; x < m_width; ++x) {
+                        fixed[x] = CostTraits<uint32_t>::fromReal(energy[x], m_costScale);
+                    }
+                    break;
+                }
+                default:
+                    copy(energy, energy + m_width, static_cast<double*>(energyData()) + row);
+                    break;
+            }
+        }
+        m_energyValid = true;
+    }
+
+    // The pixels were copied, the mapping is not needed anymore
+    if (!m_ownedPixels.empty() || m_spilledPixels.isOpen()) {
+        m_mappedPixels.close();
+    }
+}
 
+void SeamCarving::setupBuffers() {
+    if (planeCount() > 0) {
+        const size_t alignment = AlignedBuffer<uint8_t>::alignment;
+        m_planeStride = static_cast<int>((static_cast<size_t>(m_width) + 2 * SeamContext::border + alignment - 1) /
+                                         alignment * alignment);
+        size_t planes_size = planeCount() * static_cast<size_t>(m_planeStride) * m_height;
+        // Mappings start on a page, which is aligned enough
+        if (spill(m_spilledPlanes, planes_size, MappedFile::Access::Sequential)) {
+            m_planeData = m_spilledPlanes.data();
         } else {
-            auto seam = findForwardSeam();
-            removeSeam(seam);
+            m_planes.resize(planes_size);
+            m_planeData = m_planes.data();
         }
     }
+
+    m_engine = &selectSeamEngine(settings);
+
+    // The cost of a seam is at most the cost of one step, rounded up, times the number of rows:
+    // pick the largest power of two scale up to 65536 keeping it below the fixed-point maximum.
+    // The tallest images get a scale below 1, coarser costs rather than saturated ones.
+    double max_step = m_engine->maxStep;
+    m_costScale = 65536.0;
+    while ((m_costScale * max_step + 1.0) * m_height >= 4294967295.0) {
+        m_costScale /= 2.0;
+    }
+
+    // Width only decreases while carving, so buffers sized for the original image are enough for every seam
+    m_seam = Seam(m_height);
+    m_gradientRow.resize(m_width);
+    m_edgeFromLeft.resize(m_width);
+    m_edgeFromRight.resize(m_width);
+    energyData();
+    accountMemory();
+    planSearch();
 }
 
-// Save the computed energy values into an image file
-bool SeamCarving::saveEnergyToFile(const string& filename) {
-    size_t dataSize = m_width * m_height * 4;
-    vector<unsigned char> energy_img(dataSize);
+// Bytes held by each use of the buffers. Called whenever some of them were allocated or grown.
+void SeamCarving::accountMemory() {
+    size_t pixels = !m_ownedPixels.empty() ? m_ownedPixels.capacity() * sizeof(Pixel) :
+                    m_spilledPixels.isOpen() ? 0 : static_cast<size_t>(m_stride) * m_height * sizeof(Pixel);
+    m_memory.set(MemoryUse::Pixels, pixels);
+    m_memory.set(MemoryUse::Planes, m_planes.size());
+    m_memory.set(MemoryUse::Energy, m_energyDouble.capacity() * sizeof(double) +
+                                    m_energyFloat.capacity() * sizeof(float) +
+                                    m_energyFixed.capacity() * sizeof(uint32_t));
+    m_memory.set(MemoryUse::Search, m_scratch.capacity());
+    m_memory.set(MemoryUse::Seams, (m_seam.capacity() + m_seamHistory.capacity() + m_gradientRow.capacity() +
+                                    m_edgeFromLeft.capacity() + m_edgeFromRight.capacity()) * sizeof(int32_t));
+}
 
-    // Convert energy values into a linear unsigned char array
-    for (int x = 0; x < m_height; ++x) {
-        auto ite = energy[x].begin();
-        auto itd = m_data[x].begin();
-        for (int y = 0; y < m_width; y++) {
-            int idx = (x * m_width + y) * 4;
-
-            energy_img[idx]     = *ite;
-            energy_img[idx + 1] = *ite;
-            energy_img[idx + 2] = *ite;
-            energy_img[idx + 3] = (*itd).a;
-            ite = next(ite);
-            itd = next(itd);
-        }
+bool SeamCarving::spill(MappedFile& file, size_t bytes, MappedFile::Access access) {
+    if (file.isOpen()) {
+        return true;
+    }
+    if (!settings.outOfCore || m_spillFailed || bytes == 0) {
+        return false;
     }
+    string directory = settings.spillDirectory;
+    if (directory.empty()) {
+        const char* tmpdir = getenv("TMPDIR");
+        directory = tmpdir && *tmpdir ? tmpdir : "/tmp";
+    }
+    if (!file.createTemporary(directory, bytes)) {
+        cerr << "Couldn't create a temporary file in " << directory << ", carving in memory" << endl;
+        m_spillFailed = true;
+        return false;
+    }
+    file.advise(access);
+    m_memory.setSpilled(m_memory.stats().spilled + bytes);
+    return true;
+}
 
-    // Save the image using STB Image library
-    return stbi_write_png(filename.c_str(), m_width, m_height, 4, energy_img.data(), m_width * 4);
+// Padded rows for an image of m_width x m_height
+void SeamCarving::allocatePixels() {
+    m_stride = m_width + 2 * SeamContext::border;
+    size_t size = static_cast<size_t>(m_stride) * m_height;
+    if (spill(m_spilledPixels, size * sizeof(Pixel), MappedFile::Access::Sequential)) {
+        m_data = reinterpret_cast<Pixel*>(m_spilledPixels.data());
+    } else {
+        m_ownedPixels = vector<Pixel>(size);
+        m_data = m_ownedPixels.data();
+    }
 }
 
-double pixel_diff_squared(const Pixel &a, const Pixel &b) {
-    double dr = static_cast<int>(a.r) - static_cast<int>(b.r);
-    double dg = static_cast<int>(a.g) - static_cast<int>(b.g);
-    double db = static_cast<int>(a.b) - static_cast<int>(b.b);
-    
-    return dr * dr + dg * dg + db * db;
+// Bytes left to the seam search by the budgets, and its scratch memory sized accordingly:
+// the full tables when they fit, the checkpoints otherwise. `coming_bytes` are about to be
+// allocated by another use.
+void SeamCarving::planSearch(size_t coming_bytes) {
+    m_searchBudget = settings.dpMemoryBudget > 0 ? settings.dpMemoryBudget : numeric_limits<size_t>::max();
+    if (settings.memoryBudget > 0) {
+        size_t others = m_memory.live() - m_memory.live(MemoryUse::Search) + coming_bytes;
+        m_searchBudget = std::min(m_searchBudget, settings.memoryBudget > others ? settings.memoryBudget - others : 0);
+    }
+
+    size_t scratch_bytes = dpTableBytes();
+    if (scratch_bytes > m_searchBudget || m_spilledBackPointers.isOpen()) {
+        // Out of core the back-pointers go to their temporary file, only the dp rows stay in memory.
+        // Once there they stay for every later search, narrower tables included.
+        bool spilled = spill(m_spilledBackPointers, static_cast<size_t>(m_width) * m_height, MappedFile::Access::Normal);
+        scratch_bytes = spilled ? dpRowBytes() : std::max(m_searchBudget, checkpointedBytes());
+    }
+    if (m_scratch.capacity() < scratch_bytes || m_scratch.capacity() > std::max(scratch_bytes, m_searchBudget)) {
+        // The old block is released first, both are never held at once
+        m_scratch = ScratchArena();
+        m_scratch.reserve(scratch_bytes);
+        m_memory.set(MemoryUse::Search, m_scratch.capacity());
+    }
 }
 
-Pixel SeamCarving::getPixel(int y, int x) const {
-    auto it = m_data[y].begin();
-    std::advance(it, x);
-    return *it;
+MemoryStats SeamCarving::getMemoryStats() const {
+    return m_memory.stats();
 }
 
-// Compute energy for each pixel based on the color gradient
-void SeamCarving::computeEnergy() {
-    energy = vector<list<double>>(m_height, list<double>());
+void SeamCarving::prepareRow(int y) {
+    mirrorBorder(&m_data[static_cast<size_t>(y) * m_stride + SeamContext::border], m_width);
+    if (planeCount() > 0) {
+        splitPlaneRow(y);
+    }
+}
 
-    // Compute energy for each pixel
-    for (int y = 0; y < m_height; ++y) {
-        for (int x = 0; x < m_width; ++x) {
-            auto it = m_data[y].begin();
-            advance(it, x);
-            Pixel px = *it;
+// The energy of a row needs the rows up to the radius of the metric above and below it: once
+// row y is in, the one that many rows above is done
+void SeamCarving::rowLoaded(const SeamContext& ctx, int y) {
+    prepareRow(y);
+    int radius = m_engine->energyRadius;
+    if (y >= radius) {
+        m_engine->computeEnergyRows(ctx, y - radius, y - radius + 1);
+    }
+    if (y == m_height - 1) {
+        m_engine->computeEnergyRows(ctx, std::max(y - radius + 1, 0), y + 1);
+        m_energyValid = true;
+    }
+}
 
-            double dx = 0.0;
-            if (x > 0 && x < m_width - 1) {
-                dx = pixel_diff_squared(*next(it), *prev(it));
-            }
+void SeamCarving::prepare() {
+    setupBuffers();
+    for (int y = 0; y < m_height; ++y) {
+        prepareRow(y);
+    }
+}
 
-            double dy = 0.0;
-            if (y > 0 && y < m_height - 1) {
-                dy += pixel_diff_squared(getPixel(y+1, x), getPixel(y-1, x));
-            }
-            energy[y].push_back(sqrt(dx + dy));
-        }
+// Getter functions
+vector<list<Pixel>> SeamCarving::getCarvedData() const {
+    vector<list<Pixel>> data(m_height);
+    for (int y = 0; y < m_height; ++y) {
+        data[y].assign(pixelRow(y), pixelRow(y) + m_width);
     }
+    return data;
+}
+
+int SeamCarving::getCarvedWidth() const {
+    return m_width;
+}
+
+int SeamCarving::getCarvedHeight() const {
+    return m_height;
 }
 
-vector<vector<int>> SeamCarving::findBackwardSeam() const {
-    // Implementation of the findBackwardSeam function
-    // The dynamic programming table (dp) stores the lowest energy cost to reach each pixel
-    // It also keeps track of the path that led to this lowest cost (dp_idx)
-    vector<vector<double>> dp(m_height, vector<double>(m_width, 0.0));
-    vector<vector<int>> dp_idx(m_height, vector<int>(m_width, -1));
+CarvedView SeamCarving::getCarvedView() const {
+    return CarvedView{m_height > 0 ? pixelRow(0) : nullptr, m_width, m_height, m_stride};
+}
+
+const Pixel* SeamCarving::getCarvedRow(int y) const {
+    return pixelRow(y);
+}
+
+int SeamCarving::getRemovedSeamCount() const {
+    // An empty image (one that could not be loaded) has no seams
+    return m_height > 0 ? static_cast<int>(m_seamHistory.size() / m_height) : 0;
+}
+
+// The n most recently removed seams, oldest first
+SeamSpan SeamCarving::getLastSeams(int n) const {
+    int count = std::min(n, getRemovedSeamCount());
+    size_t first = static_cast<size_t>(getRemovedSeamCount() - count) * m_height;
+    return SeamSpan{m_seamHistory.data() + first, count, m_height};
+}
+
+SeamContext SeamCarving::context() {
+    SeamContext ctx;
+    ctx.pixels = m_data + SeamContext::border;
+    ctx.planes = m_planeData + SeamContext::border;
+    ctx.planeStride = m_planeStride;
+    ctx.energy = energyData();
+    ctx.width = m_width;
+    ctx.height = m_height;
+    ctx.stride = m_stride;
+    ctx.costScale = m_costScale;
+    ctx.scratch = &m_scratch;
+    ctx.backPointers = nullptr;
+    ctx.seam = m_seam.data();
+    ctx.checkpointStep = checkpointStep();
+    ctx.threads = std::max(settings.seamThreads, 1);
+    ctx.engine = m_engine;
+    ctx.gradient = m_gradientRow.data();
+    ctx.edgeFromLeft = m_edgeFromLeft.data();
+    ctx.edgeFromRight = m_edgeFromRight.data();
+    return ctx;
+}
 
-    int x = 0;
-    for (auto v : energy[0]) {
-        dp[0][x] = v;
-        x++;
+// Energy buffer of the cost type in use, allocated on first use
+void* SeamCarving::energyData() {
+    if (m_energy) {
+        return m_energy;
     }
+    size_t size = static_cast<size_t>(m_stride) * m_height;
+    if (spill(m_spilledEnergy, size * costSize(), MappedFile::Access::Sequential)) {
+        m_energy = m_spilledEnergy.data();
+        return m_energy;
+    }
+    switch (settings.costType) {
+        case CostType::Float:
+            m_energyFloat.resize(size);
+            m_energy = m_energyFloat.data();
+            break;
+        case CostType::Fixed:
+            m_energyFixed.resize(size);
+            m_energy = m_energyFixed.data();
+            break;
+        default:
+            m_energyDouble.resize(size);
+            m_energy = m_energyDouble.data();
+            break;
+    }
+    return m_energy;
+}
 
-    for (int y = 1; y < m_height; ++y) {
-        x = 0;
-        for (auto v : energy[y]) {
-            int min_idx = x;
-            double min_val = dp[y - 1][x] + v;
+// Energy of a pixel converted back to a real value, whatever the cost type
+double SeamCarving::energyAt(int y, int x) const {
+    size_t i = static_cast<size_t>(y) * m_stride + x;
+    switch (settings.costType) {
+        case CostType::Float:
+            return static_cast<const float*>(m_energy)[i];
+        case CostType::Fixed:
+            return CostTraits<uint32_t>::toReal(static_cast<const uint32_t*>(m_energy)[i], m_costScale);
+        default:
+            return static_cast<const double*>(m_energy)[i];
+    }
+}
 
-            for (int x_offset : {-1, 1}) {
-                int nx = x + x_offset;
-                if (nx >= 0 && nx < m_width) {
-                    double new_val = dp[y - 1][nx] + v;
-                    if (new_val < min_val) {
-                        min_val = new_val;
-                        min_idx = nx;
-                    }
-                }
-            }
+size_t SeamCarving::costSize() const {
+    switch (settings.costType) {
+        case CostType::Float:
+            return sizeof(float);
+        case CostType::Fixed:
+            return sizeof(uint32_t);
+        default:
+            return sizeof(double);
+    }
+}
 
-            dp[y][x] = min_val;
-            dp_idx[y][x] = min_idx;
-            x++;
-        }
+// Main carve function
+void SeamCarving::carve(int num_seams) {
+    // At least one column is kept
+    num_seams = std::max(std::min(num_seams, m_width - 1), 0);
+    SeamContext ctx = context();
+    if (!m_energyValid) {
+        m_engine->computeEnergy(ctx);
+        m_energyValid = true;
+    }
+    carveSeams(ctx, num_seams);
+    if (planarPixels()) {
+        mergePlanes();
     }
+}
 
-    double min_path_cost = std::numeric_limits<double>::max();
-    int seam_end_x = -1;
-    for (int x = 0; x < m_width; ++x) {
-    	if (dp[m_height - 1][x] < min_path_cost) {
-            min_path_cost = dp[m_height - 1][x];
-            seam_end_x = x;
+void SeamCarving::carveToWidths(vector<int> widths, const function<void(int, const SeamCarving&)>& onWidth) {
+    sort(widths.rbegin(), widths.rend());
+
+    // The energy is kept up to date by the seam removals, it is only computed once for all widths
+    SeamContext ctx = context();
+    if (!m_energyValid) {
+        m_engine->computeEnergy(ctx);
+        m_energyValid = true;
+    }
+    int last_width = 0;
+    for (int width : widths) {
+        width = std::max(std::min(width, m_width), 1);
+        // Widths clamped to the same one are reached once
+        if (width == last_width) {
+            continue;
+        }
+        carveSeams(ctx, m_width - width);
+        if (planarPixels()) {
+            mergePlanes();
         }
+        last_width = width;
+        onWidth(m_width, *this);
     }
+}
 
-    vector<vector<int>> seam(m_height, vector<int>(2, 0));
+vector<CarvedImage> SeamCarving::carveToWidths(const vector<int>& widths) {
+    vector<CarvedImage> images(widths.size());
+    int original_width = m_width;
+    carveToWidths(widths, [&](int width, const SeamCarving& carved) {
+        CarvedImage image = carved.snapshot();
+        for (size_t i = 0; i < widths.size(); ++i) {
+            if (std::max(std::min(widths[i], original_width), 1) == width) {
+                images[i] = image;
+            }
+        }
+    });
+    return images;
+}
 
-    x = seam_end_x;
-    for (int y = m_height - 1; y >= 0; --y) {
-        seam[y][0] = y;
-        seam[y][1] = x;
-        x = dp_idx[y][x];
+// Remove num_seams seams, ctx must hold the current energy
+void SeamCarving::carveSeams(SeamContext& ctx, int num_seams) {
+    m_memory.setPhase(MemoryPhase::Carve);
+    // The search makes room for the seams about to be recorded before they are allocated
+    size_t history_size = m_seamHistory.size() + static_cast<size_t>(num_seams) * m_height;
+    planSearch(history_size > m_seamHistory.capacity() ? (history_size - m_seamHistory.capacity()) * sizeof(int32_t) : 0);
+    m_seamHistory.reserve(history_size);
+    accountMemory();
+    for (int i = 0; i < num_seams; ++i) {
+        // Fall back to the checkpointed search when the full tables would not fit in the budget,
+        // or out of core keep their back-pointers in a temporary file. The scratch memory was
+        // planned for the spilled ones: they are used even when the table shrinks into the budget.
+        bool spilled = m_spilledBackPointers.isOpen();
+        bool checkpointed = !spilled && dpTableBytes() > m_searchBudget;
+        ctx.backPointers = spilled ? reinterpret_cast<int8_t*>(m_spilledBackPointers.data()) : nullptr;
+        if (i == 0) {
+            (checkpointed ? m_engine->findCheckpointedSeam : m_engine->findSeam)(ctx);
+        } else {
+            // The previous seam is removed by the same sweep over the rows as the search
+            (checkpointed ? m_engine->removeAndFindCheckpointedSeam : m_engine->removeAndFindSeam)(ctx);
+            ctx.width = --m_width;
+        }
+        m_seamHistory.insert(m_seamHistory.end(), m_seam.begin(), m_seam.end());
+    }
+    if (num_seams > 0) {
+        removeSeam(ctx);
+        ctx.width = m_width;
     }
+}
 
-    return seam;
+int SeamCarving::planeCount() const {
+    if (settings.usesLuminancePlane()) {
+        return settings.alphaInEnergy ? 2 : 1;
+    }
+    return settings.planarLayout ? 4 : 0;
 }
 
-vector<vector<int>> SeamCarving::findForwardSeam() const {
-    // Implementation of the findForwardSeam function
-    // The difference between forward and backward seam carving methods is that the forward method accounts
-    // for the energy introduced by connecting neighboring pixels when a seam has been removed,
-    // whereas the backward method ignores this newly introduced energy.
-    // The forward method often yields better visual results.
+bool SeamCarving::planarPixels() const {
+    return planeCount() == 4;
+}
 
-    // The dynamic programming table (dp) stores the lowest energy cost to reach each pixel
-    // It also keeps track of the path that led to this lowest cost (dp_idx)
-    vector<vector<double>> dp(m_height, vector<double>(m_width, std::numeric_limits<double>::max()));
-    vector<vector<int>> dp_idx(m_height, vector<int>(m_width, -1));
+// Copy row y of the interleaved pixels into the planes, borders included
+void SeamCarving::splitPlaneRow(int y) {
+    size_t plane_size = static_cast<size_t>(m_planeStride) * m_height;
+    const Pixel* row = pixelRow(y);
+    if (settings.usesLuminancePlane()) {
+        uint8_t* luma = m_planeData + SeamContext::border + static_cast<size_t>(y) * m_planeStride;
+        for (int x = -SeamContext::border; x < m_width + SeamContext::border; ++x) {
+            luma[x] = static_cast<uint8_t>(LuminanceMetric<3>::luma(row[x]));
+        }
+        if (settings.alphaInEnergy) {
+            uint8_t* alpha = luma + plane_size;
+            for (int x = -SeamContext::border; x < m_width + SeamContext::border; ++x) {
+                alpha[x] = row[x].a;
+            }
+        }
+        return;
+    }
 
-    for (int x = 0; x < m_width; ++x) {
-        dp[0][x] = 0.0;
+    uint8_t* r = m_planeData + SeamContext::border + static_cast<size_t>(y) * m_planeStride;
+    uint8_t* g = r + plane_size;
+    uint8_t* b = g + plane_size;
+    uint8_t* a = b + plane_size;
+    for (int x = -SeamContext::border; x < m_width + SeamContext::border; ++x) {
+        r[x] = row[x].r;
+        g[x] = row[x].g;
+        b[x] = row[x].b;
+        a[x] = row[x].a;
     }
+}
 
-    for (int y = 0; y < m_height - 1; ++y) {
+// Interleave the channel planes back into the pixels
+void SeamCarving::mergePlanes() {
+    size_t plane_size = static_cast<size_t>(m_planeStride) * m_height;
+    const uint8_t* r = m_planeData + SeamContext::border;
+    const uint8_t* g = r + plane_size;
+    const uint8_t* b = g + plane_size;
+    const uint8_t* a = b + plane_size;
+    for (int y = 0; y < m_height; ++y) {
+        Pixel* row = &m_data[static_cast<size_t>(y) * m_stride + SeamContext::border];
+        size_t offset = static_cast<size_t>(y) * m_planeStride;
         for (int x = 0; x < m_width; ++x) {
-            double left_energy = x > 0 ? pixel_diff_squared(getPixel(y + 1, x - 1), getPixel(y, x + 1)) : std::numeric_limits<double>::max();
-            double right_energy = x < m_width - 1 ? pixel_diff_squared(getPixel(y + 1, x + 1), getPixel(y, x - 1)) : std::numeric_limits<double>::max();
+            row[x] = Pixel{r[offset + x], g[offset + x], b[offset + x], a[offset + x]};
+        }
+        mirrorBorder(row, m_width);
+    }
+}
 
-            auto current_energy = energy[y + 1].begin();
-            std::advance(current_energy, x);
+// This function takes the last computed seam and removes it from the image.
+void SeamCarving::removeSeam(const SeamContext& ctx) {
+    m_engine->removeSeam(ctx);
 
-            if (dp[y][x] + left_energy < dp[y + 1][x - 1]) {
-                dp[y + 1][x - 1] = dp[y][x] + left_energy;
-                dp_idx[y + 1][x - 1] = x;
-            }
+    // Update the width of the image
+    m_width--;
+}
 
-            if (dp[y][x] + (*current_energy) < dp[y + 1][x]) {
-                dp[y + 1][x] = dp[y][x] + (*current_energy);
-                dp_idx[y + 1][x] = x;
-            }
+// Row of the energy image: the energy clamped to 255 as gray, with the alpha of the pixels
+void SeamCarving::energyImageRow(int y, unsigned char* rgba) const {
+    const Pixel* itd = pixelRow(y);
+    for (int x = 0; x < m_width; x++, rgba += 4) {
+        unsigned char e = static_cast<unsigned char>(std::min(energyAt(y, x), 255.0));
 
-            if (dp[y][x] + right_energy < dp[y + 1][x + 1]) {
-                dp[y + 1][x + 1] = dp[y][x] + right_energy;
-                dp_idx[y + 1][x + 1] = x;
-            }
-        }
+        rgba[0] = e;
+        rgba[1] = e;
+        rgba[2] = e;
+        rgba[3] = itd[x].a;
     }
+}
 
-    double min_path_cost = std::numeric_limits<double>::max();
-    int seam_end_x = -1;
-    for (int x = 0; x < m_width; ++x) {
-        if (dp[m_height - 1][x] < min_path_cost) {
-            min_path_cost = dp[m_height - 1][x];
-            seam_end_x = x;
+// Save the computed energy values into an image file
+bool SeamCarving::saveEnergyToFile(const string& filename, const PngOptions& options) {
+    if (hasQoiExtension(filename)) {
+        // Streamed one row at a time
+        QoiWriter writer;
+        vector<unsigned char> row(static_cast<size_t>(m_width) * 4);
+        bool ok = writer.open(filename, m_width, m_height);
+        for (int y = 0; ok && y < m_height; ++y) {
+            energyImageRow(y, row.data());
+            ok = writer.writeRow(row.data());
         }
+        return writer.close() && ok;
     }
 
-    vector<vector<int>> seam(m_height, vector<int>(2, 0));
+    size_t dataSize = static_cast<size_t>(m_width) * m_height * 4;
+    vector<unsigned char> energy_img(dataSize);
+    for (int y = 0; y < m_height; ++y) {
+        energyImageRow(y, &energy_img[static_cast<size_t>(y) * m_width * 4]);
+    }
+    return writePng(filename, energy_img.data(), m_width, m_height, 4, static_cast<size_t>(m_width) * 4, options);
+}
 
-    int x = seam_end_x;
-    for (int y = m_height - 1; y >= 0; --y) {
-        seam[y][0] = y;
-        seam[y][1] = x;
-        x = dp_idx[y][x];
+void SeamCarving::copyCarvedPixels(unsigned char* rgba) const {
+    for (int y = 0; y < m_height; ++y) {
+        memcpy(rgba + static_cast<size_t>(y) * m_width * 4, pixelRow(y), static_cast<size_t>(m_width) * sizeof(Pixel));
     }
+}
 
-    return seam;
+CarvedImage SeamCarving::snapshot() const {
+    CarvedImage image{m_width, m_height, vector<unsigned char>(static_cast<size_t>(m_width) * m_height * 4)};
+    copyCarvedPixels(image.rgba.data());
+    return image;
 }
 
-// This function takes the computed seam and removes it from the original image.
-void SeamCarving::removeSeam(const std::vector<std::vector<int>>& seam) {
-    // Compute new width of the image after removal of the seam
-    int new_width = m_width - 1;
+Pixel SeamCarving::getPixel(int y, int x) const {
+    return pixelRow(y)[x];
+}
 
-    // Iterate through each row of the image and remove the pixel that belongs to the seam from m_data and energy tables
-    for (int y = 0; y < m_height; ++y) {
-        int seam_x = seam[y][1];
-        
-        std::list<double>::iterator energy_it = energy[y].begin();
-        std::advance(energy_it, seam_x);
-        energy[y].erase(energy_it);
+const Pixel* SeamCarving::pixelRow(int y) const {
+    return &m_data[static_cast<size_t>(y) * m_stride + SeamContext::border];
+}
 
-        std::list<Pixel>::iterator data_it = m_data[y].begin();
-        std::advance(data_it, seam_x);
-        m_data[y].erase(data_it);
-    }
-    
-    // Update the width of the image
-    m_width = new_width;
+int SeamCarving::checkpointStep() const {
+    return std::max(static_cast<int>(std::ceil(std::sqrt(static_cast<double>(m_height)))), 1);
+}
+
+// Scratch memory of the dp rows of the full-table seam searches: two rows (with their sentinel
+// cells), or a band of them for the tiled search
+size_t SeamCarving::dpRowBytes() const {
+    return settings.seamThreads > 1 ?
+        ScratchArena::bytesFor<char>((DpTile::maxRows + 1) * (static_cast<size_t>(m_width) + 2) * costSize()) :
+        2 * ScratchArena::bytesFor<char>((m_width + 2) * costSize());
+}
+
+// Scratch memory needed by the full-table seam searches: the dp rows and the whole table of
+// 1-byte back-pointers
+size_t SeamCarving::dpTableBytes() const {
+    return dpRowBytes() + ScratchArena::bytesFor<int8_t>(static_cast<size_t>(m_width) * m_height);
+}
+
+// Scratch memory needed by the checkpointed seam search
+size_t SeamCarving::checkpointedBytes() const {
+    int step = checkpointStep();
+    size_t num_checkpoints = (m_height - 1) / step + 1;
+    return ScratchArena::bytesFor<char>(num_checkpoints * m_width * costSize()) +
+           2 * ScratchArena::bytesFor<char>((m_width + 2) * costSize()) +
+           ScratchArena::bytesFor<int8_t>(static_cast<size_t>(step) * m_width);
 }
 
-bool SeamCarving::saveCarvedImageToFile(const std::string& filename) const {
+bool SeamCarving::saveCarvedImageToFile(const std::string& filename, const PngOptions& options) const {
+    if (hasRawImageExtension(filename)) {
+        return saveRawImageToFile(filename, true, false);
+    }
+    if (hasQoiExtension(filename)) {
+        return writeQoi(filename, reinterpret_cast<const unsigned char*>(pixelRow(0)), m_width, m_height,
+                        m_stride * sizeof(Pixel));
+    }
     int num_channels = 4;
 
-    // Allocate memory for the linear unsigned char array
-    unsigned char* linear_data = new unsigned char[m_width * m_height * num_channels];
-
-    // Convert the m_data structure to a linear unsigned char array
-    for (int x = 0; x < m_height; ++x) {
-        int y = 0;
-        for (const Pixel& pixel : m_data[x]) {
-            int idx = (x * m_width + y) * num_channels;
-            linear_data[idx] = pixel.r;
-            linear_data[idx + 1] = pixel.g;
-            linear_data[idx + 2] = pixel.b;
-            linear_data[idx + 3] = pixel.a;
-            ++y;
-        }
+    // Rows are already laid out as RGBA, only the stride differs from the carved width
+    return writePng(filename, reinterpret_cast<const unsigned char*>(pixelRow(0)), m_width, m_height, num_channels, m_stride * sizeof(Pixel), options);
+}
+
+vector<unsigned char> SeamCarving::encodeCarvedImage(const PngOptions& options) const {
+    return encodePng(reinterpret_cast<const unsigned char*>(pixelRow(0)), m_width, m_height, 4, m_stride * sizeof(Pixel), options);
+}
+
+static size_t alignRaw(size_t offset) {
+    return (offset + rawImageAlignment - 1) / rawImageAlignment * rawImageAlignment;
+}
+
+bool SeamCarving::saveRawImageToFile(const std::string& filename, bool with_energy, bool with_seam_map) const {
+    // Rows keep the borders, so that the file can be carved again straight from its mapping
+    const int pixels_per_line = rawImageAlignment / sizeof(Pixel);
+    int stride = (m_width + 2 * SeamContext::border + pixels_per_line - 1) / pixels_per_line * pixels_per_line;
+    int original_width = m_width + getRemovedSeamCount();
+    with_energy = with_energy && m_energyValid;
+
+    RawImageHeader header = {};
+    memcpy(header.magic, rawImageMagic, sizeof(rawImageMagic));
+    header.version = rawImageVersion;
+    header.headerSize = sizeof(RawImageHeader);
+    header.width = m_width;
+    header.height = m_height;
+    header.stride = stride;
+    header.padding = SeamContext::border;
+    header.pixelOffset = alignRaw(sizeof(RawImageHeader));
+    size_t end = header.pixelOffset + static_cast<size_t>(stride) * m_height * sizeof(Pixel);
+    if (with_energy) {
+        header.energyOffset = alignRaw(end);
+        header.energyKind = rawEnergyKind(settings);
+        end = header.energyOffset + static_cast<size_t>(stride) * m_height * sizeof(double);
+    }
+    if (with_seam_map) {
+        header.seamMapWidth = original_width;
+        header.seamMapOffset = alignRaw(end);
+        end = header.seamMapOffset + static_cast<size_t>(original_width) * m_height * sizeof(int32_t);
+    }
+
+    MappedFile file;
+    if (!file.create(filename, end)) {
+        cerr << "Couldn't write file " << filename << endl;
+        return false;
+    }
+    memcpy(file.data(), &header, sizeof(header));
+
+    Pixel* pixels = reinterpret_cast<Pixel*>(file.data() + header.pixelOffset);
+    for (int y = 0; y < m_height; ++y) {
+        memcpy(pixels + static_cast<size_t>(y) * stride, pixelRow(y) - SeamContext::border,
+               (m_width + 2 * SeamContext::border) * sizeof(Pixel));
     }
 
-    // Save the image using stbi_write_png()
-    bool success = stbi_write_png(filename.c_str(), m_width, m_height, num_channels, linear_data, m_width * num_channels);
+    if (with_energy) {
+        double* energy = reinterpret_cast<double*>(file.data() + header.energyOffset);
+        for (int y = 0; y < m_height; ++y) {
+            for (int x = 0; x < m_width; ++x) {
+                energy[static_cast<size_t>(y) * stride + x] = energyAt(y, x);
+            }
+        }
+    }
 
-    // Free the memory allocated for the linear unsigned char array
-    delete[] linear_data;
+    if (with_seam_map) {
+        // Follow the original column of every remaining pixel while replaying the removals
+        int32_t* seam_map = reinterpret_cast<int32_t*>(file.data() + header.seamMapOffset);
+        int num_seams = getRemovedSeamCount();
+        vector<int32_t> columns(original_width);
+        for (int y = 0; y < m_height; ++y) {
+            int32_t* map_row = seam_map + static_cast<size_t>(y) * original_width;
+            fill(map_row, map_row + original_width, -1);
+            for (int x = 0; x < original_width; ++x) {
+                columns[x] = x;
+            }
+            for (int i = 0; i < num_seams; ++i) {
+                int x = m_seamHistory[static_cast<size_t>(i) * m_height + y];
+                map_row[columns[x]] = i;
+                copy(columns.begin() + x + 1, columns.begin() + (original_width - i), columns.begin() + x);
+            }
+        }
+    }
 
-    return success;
+    if (!file.close()) {
+        cerr << "Couldn't write file " << filename << endl;
+        return false;
+    }
+    return true;
 }
@@ -7,8 +7,18 @@
 #include <list>
 #include <limits>
 #include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <cstdlib>
 
 #include "settings.h"
+#include "scratchArena.h"
+#include "costTypes.h"
+#include "alignedBuffer.h"
+#include "mappedFile.h"
+#include "pngEncoder.h"
+#include "memoryAccount.h"
 
 using namespace std;
 
@@ -16,36 +26,247 @@ struct Pixel {
     unsigned char r, g, b, a;
 };
 
+// Layouts of the caller-owned pixels a SeamCarving can be built from, 8 bits per channel
+enum class PixelFormat {
+    RGBA,
+    BGRA,
+    RGB,
+    Gray
+};
+
+// Caller-owned image, row y starts at data + y * stride bytes
+struct ImageView {
+    const unsigned char* data;
+    int width;
+    int height;
+    size_t stride;
+    PixelFormat format;
+};
+
+// Pixels laid out the way SeamCarving carves them in place: row y starts at y * stride and
+// holds `border` spare pixels, then the width pixels of the image, then `border` spare pixels
+// again (see SeamContext). Fill it and move it into a SeamCarving to build one without a copy.
+struct PixelBuffer {
+    static constexpr int border = 2;
+
+    vector<Pixel> pixels;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+
+    PixelBuffer() = default;
+    // stride 0 means the smallest stride, width + 2 * border
+    PixelBuffer(int w, int h, int s = 0) : width(w), height(h), stride(s > 0 ? s : w + 2 * border) {
+        pixels.resize(static_cast<size_t>(stride) * height);
+    }
+
+    Pixel* row(int y) { return pixels.data() + static_cast<size_t>(y) * stride + border; }
+    const Pixel* row(int y) const { return pixels.data() + static_cast<size_t>(y) * stride + border; }
+};
+
+// A vertical seam, seam[y] is the column of the pixel removed in row y
+using Seam = vector<int32_t>;
+
+// Read-only view over consecutive seams stored contiguously, seam i starts at data + i * height.
+// Columns are relative to the image as it was when the seam was removed.
+struct SeamSpan {
+    const int32_t* data;
+    int count;
+    int height;
+
+    const int32_t* seam(int i) const { return data + static_cast<size_t>(i) * height; }
+};
+
+// Read-only view of the carved pixels, pixel (x, y) is data[y * stride + x].
+// Valid until the image is carved again or destroyed.
+struct CarvedView {
+    const Pixel* data;
+    int width;
+    int height;
+    int stride;
+
+    const Pixel* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+    const Pixel& at(int x, int y) const { return row(y)[x]; }
+};
+
+// Packed RGBA copy of a carved image
+struct CarvedImage {
+    int width;
+    int height;
+    vector<unsigned char> rgba;
+};
+
+struct SeamEngine;
+struct SeamContext;
+
+// Largest width and height of an image. Rows, borders and padding included (the planes round
+// theirs up to 64 bytes), hold at most INT_MAX pixels; every offset into the image is computed
+// in size_t.
+constexpr int maxImageSize = numeric_limits<int>::max() - 128;
+
 class SeamCarving {
 public:
+    // Decodes any format of stb_image or a QOI file, or maps a .scraw file (see rawImage.h),
+    // whatever its name. stb_image only decodes images below 2 GiB of RGBA (about 536
+    // megapixels), larger ones are read from .qoi or .scraw files.
     SeamCarving(const std::string& filename, Settings s);
-    // Run seam carving for the desired number of seams.
+    // Copy the caller's pixels, converted to RGBA, straight into the carving buffer
+    SeamCarving(const ImageView& view, Settings s);
+    // Carve `pixels` in place, without any copy. Throws invalid_argument if its stride or size
+    // cannot hold the borders.
+    SeamCarving(PixelBuffer&& pixels, Settings s);
+    // Run seam carving for the desired number of seams, clamped to [0, current width - 1].
     void carve(int num_seams);
+    // Carve once down to the smallest of `widths`, calling onWidth(width, *this) each time the
+    // image reaches one of them, from the largest to the smallest. Widths are clamped to
+    // [1, current width] and `width` is the one reached, once for widths clamped alike. The
+    // callback may copy the image and hand it to another thread, carving resumes when it returns.
+    void carveToWidths(vector<int> widths, const function<void(int, const SeamCarving&)>& onWidth);
+    // Same, returning a snapshot of the image at each width, in the order of `widths`
+    vector<CarvedImage> carveToWidths(const vector<int>& widths);
 
+    // Deep copy of the carved image, getCarvedView() reads it without any allocation
     vector<list<Pixel>> getCarvedData() const;
     int getCarvedWidth() const;
     int getCarvedHeight() const;
+    CarvedView getCarvedView() const;
+    const Pixel* getCarvedRow(int y) const;
+    // Copy the carved image into `rgba`, rows of getCarvedWidth() RGBA pixels without padding
+    void copyCarvedPixels(unsigned char* rgba) const;
+    CarvedImage snapshot() const;
+
+    SeamCarving(SeamCarving&&) = default;
+    SeamCarving& operator=(SeamCarving&&) = default;
+    SeamCarving(const SeamCarving&) = delete;
+    SeamCarving& operator=(const SeamCarving&) = delete;
 
     Settings settings;
 
-    Pixel getPixel(int x, int y) const;
+    Pixel getPixel(int y, int x) const;
 
-    bool saveEnergyToFile(const std::string& filename);
-    bool saveCarvedImageToFile(const std::string& filename) const;
+    // Seams removed so far, in removal order
+    int getRemovedSeamCount() const;
+    SeamSpan getLastSeams(int n) const;
+
+    // Bytes used by the buffers of this instance, by use and with the peaks of each phase
+    MemoryStats getMemoryStats() const;
+
+    bool saveEnergyToFile(const std::string& filename, const PngOptions& options = PngOptions());
+    // PNG file, QOI file when the name ends with .qoi, or .scraw file with the energy when it
+    // ends with .scraw
+    bool saveCarvedImageToFile(const std::string& filename, const PngOptions& options = PngOptions()) const;
+    // Write a .scraw file through a mapping. The energy is only stored once computed by carve().
+    // The seam map has one entry per pixel of the image before carving.
+    bool saveRawImageToFile(const std::string& filename, bool with_energy, bool with_seam_map) const;
+    // PNG file of the carved image, in memory. Empty if the encoding failed.
+    vector<unsigned char> encodeCarvedImage(const PngOptions& options = PngOptions()) const;
 
 private:
-    vector<list<Pixel>> m_data;
-    //unsigned char* m_data;
+    // Pixels of the image, pixel (x, y) is at y * m_stride + x + SeamContext::border. Rows are
+    // compacted in place when a seam is removed, m_stride stays the width of the original image
+    // plus the mirrored borders on both sides (or more for a mapped .scraw file).
+    // They live in m_ownedPixels, in m_decodedPixels when stb decoded them, in m_mappedPixels
+    // when carved straight from a .scraw file, or in m_spilledPixels out of core.
+    Pixel* m_data = nullptr;
+    vector<Pixel> m_ownedPixels;
+    unique_ptr<unsigned char, void (*)(void*)> m_decodedPixels{nullptr, free};
+    MappedFile m_mappedPixels;
+    MappedFile m_spilledPixels;
     int m_width;
     int m_height;
+    int m_stride;
+
+    // With settings.planarLayout, one plane per channel with rows (borders included) padded to a multiple of 64 bytes.
+    // The planes are carved instead of m_data, which is rebuilt from them at the end of carve().
+    // With settings.luminancePlane, the luminance plane (and the alpha plane when it counts in the
+    // energy) is carved along with m_data instead.
+    // m_planeData points into m_planes, or into m_spilledPlanes out of core.
+    AlignedBuffer<uint8_t> m_planes;
+    MappedFile m_spilledPlanes;
+    uint8_t* m_planeData = nullptr;
+    int m_planeStride;
+
+    // Energy of each pixel, row y starts at y * m_stride, without borders. m_energy points into
+    // the buffer of settings.costType, or into m_spilledEnergy out of core.
+    void* m_energy = nullptr;
+    vector<double> m_energyDouble;
+    vector<float> m_energyFloat;
+    vector<uint32_t> m_energyFixed;
+    MappedFile m_spilledEnergy;
+    // Fixed-point scale, chosen so that the cost of a seam cannot saturate
+    double m_costScale;
+    // The seam removals keep the energy up to date: it is only computed while the image is
+    // loaded, by the first carve of a PixelBuffer, or loaded with a .scraw file
+    bool m_energyValid = false;
+
+    // Temporary buffers of the seam search, sized once in the constructor and reused for every seam
+    ScratchArena m_scratch;
+    Seam m_seam;
+    // Integer gradients of a row and forward energies of the edges created by a seam
+    vector<int32_t> m_gradientRow, m_edgeFromLeft, m_edgeFromRight;
+
+    // Every removed seam, one after the other
+    vector<int32_t> m_seamHistory;
+
+    // Out of core, back-pointers of the seam searches whose full tables exceed the budgets
+    MappedFile m_spilledBackPointers;
+    // Set once a temporary file could not be created, the buffers then stay in memory
+    bool m_spillFailed = false;
+
+    // Carving engine specialised for the settings
+    const SeamEngine* m_engine;
+
+    MemoryAccount m_memory;
+    // Bytes the seam search may use within settings.dpMemoryBudget and settings.memoryBudget
+    size_t m_searchBudget;
+
+    SeamContext context();
+    void* energyData();
+    double energyAt(int y, int x) const;
+    void energyImageRow(int y, unsigned char* rgba) const;
+    size_t costSize() const;
+    const Pixel* pixelRow(int y) const;
+    // Planes next to the pixels, 0 without any
+    int planeCount() const;
+    // The planes hold the carved pixels, m_data is only rebuilt from them by mergePlanes()
+    bool planarPixels() const;
+    void splitPlaneRow(int y);
+    void mergePlanes();
+
+    void carveSeams(SeamContext& ctx, int num_seams);
+    void removeSeam(const SeamContext& ctx);
+
+    // Map `file` to a temporary file of `bytes` bytes if settings.outOfCore, false to keep the
+    // buffer in memory. A file already mapped is kept.
+    bool spill(MappedFile& file, size_t bytes, MappedFile::Access access);
+    void allocatePixels();
 
-    vector<list<double>> energy;
+    void accountMemory();
+    void planSearch(size_t coming_bytes = 0);
+    // Memory needed by the seam searches
+    size_t dpRowBytes() const;
+    size_t dpTableBytes() const;
+    size_t checkpointedBytes() const;
+    int checkpointStep() const;
 
-    // Helper functions for seam carving algorithm
-    void computeEnergy();
-    vector<vector<int>> findForwardSeam() const;
-    vector<vector<int>> findBackwardSeam() const;
-    void removeSeam(const vector<vector<int>>& seam);
+    // The loaders below store the image straight into its padded rows. All but the mapped .scraw
+    // file hand each row to rowLoaded() as soon as it is stored, which computes the energy on the way.
+    void copyFromView(const ImageView& view);
+    // Any format of stb_image
+    void decodeImage(const std::string& filename);
+    // Carve a mapped .scraw file in place, or copy its pixels if its rows have no room for the
+    // borders. Its energy is loaded afterwards by loadRawEnergy().
+    bool loadRawImage(const std::string& filename);
+    void loadRawEnergy();
+    // Decode a QOI file row by row into the padded rows, false if it is not one
+    bool loadQoiImage(const std::string& filename);
+    // Set up the buffers of the engine for an image of m_width x m_height, before its rows are stored
+    void setupBuffers();
+    // Fill the borders of a stored row and copy it into the planes
+    void prepareRow(int y);
+    void rowLoaded(const SeamContext& ctx, int y);
+    // Set up the buffers and prepare every row, once m_data holds the whole image
+    void prepare();
 };
 
 #endif // SEAMCARVING_H
@@ -0,0 +1,91 @@
+#include "seamKernels.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+const char* seamIsaName(SeamIsa isa) {
+    switch (isa) {
+        case SeamIsa::SSE42:
+            return "sse4.2";
+        case SeamIsa::AVX2:
+            return "avx2";
+        case SeamIsa::AVX512:
+            return "avx512";
+        default:
+            return "generic";
+    }
+}
+
+static SeamIsa bestSupportedIsa() {
+#ifdef SEAM_MULTI_ISA
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+        return SeamIsa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SeamIsa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return SeamIsa::SSE42;
+    }
+#endif
+    return SeamIsa::Generic;
+}
+
+static SeamIsa detectIsa() {
+    SeamIsa best = bestSupportedIsa();
+    const char* forced = getenv("SEAMCARVING_ISA");
+    if (!forced) {
+        return best;
+    }
+
+    for (SeamIsa isa : {SeamIsa::Generic, SeamIsa::SSE42, SeamIsa::AVX2, SeamIsa::AVX512}) {
+        if (strcmp(forced, seamIsaName(isa)) == 0) {
+            if (isa > best) {
+                cerr << "SEAMCARVING_ISA=" << forced << " is not supported by this CPU, using " << seamIsaName(best) << endl;
+                return best;
+            }
+            return isa;
+        }
+    }
+    cerr << "Unknown SEAMCARVING_ISA=" << forced << ", using " << seamIsaName(best) << endl;
+    return best;
+}
+
+SeamIsa seamEngineIsa() {
+    static const SeamIsa isa = detectIsa();
+    return isa;
+}
+
+// The generic engine is compiled here, the others in seamEngineSse42.cpp, seamEngineAvx2.cpp
+// and seamEngineAvx512.cpp
+const SeamEngine& selectGenericEngine(const Settings& settings) {
+    return selectVariantEngine<GenericVariant>(settings);
+}
+
+const SeamEngine& selectSeamEngine(const Settings& settings) {
+    const SeamEngine* engine = nullptr;
+    switch (seamEngineIsa()) {
+#ifdef SEAM_MULTI_ISA
+        case SeamIsa::SSE42:
+            engine = selectSse42Engine(settings);
+            break;
+        case SeamIsa::AVX2:
+            engine = selectAvx2Engine(settings);
+            break;
+        case SeamIsa::AVX512:
+            engine = selectAvx512Engine(settings);
+            break;
+#endif
+        default:
+            break;
+    }
+    return engine ? *engine : selectGenericEngine(settings);
+}
+
+SeamIsa seamEngineIsa(const Settings& settings) {
+    return selectSeamEngine(settings).isa;
+}
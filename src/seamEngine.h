@@ -0,0 +1,108 @@
+#ifndef SEAMENGINE_H
+#define SEAMENGINE_H
+
+#include "seamCarving.h"
+
+struct SeamEngine;
+
+// Raw view of the state of a SeamCarving handed to the carving engine
+struct SeamContext {
+    // Every pixel row (and plane row) has `border` extra pixels on each side, mirroring the
+    // pixels next to the image border: row[-1] == row[1], row[width] == row[width - 2], ...
+    // With them the kernels never need to test whether a neighbour is inside the image.
+    static constexpr int border = PixelBuffer::border;
+
+    Pixel* pixels;          // pixel (0, y) is at pixels + y * stride
+    uint8_t* planes;        // planar and luminance layouts: pixel (0, y) of plane c is at planes + (c * height + y) * planeStride
+    int planeStride;
+    void* energy;           // same layout as pixels, of the engine cost type
+    int width;
+    int height;
+    int stride;
+    double costScale;       // fixed-point scale of the costs
+    ScratchArena* scratch;  // dp tables, reset by every seam search
+    int8_t* backPointers;   // when set, back-pointers of the full-table searches, width x height, instead of the scratch
+    int32_t* seam;          // seam found by the last search, one column per row
+    int checkpointStep;     // rows between two checkpoints of the checkpointed search
+    int threads;            // parallel tasks of the energy and seam search, 1 runs them on the calling thread
+    const SeamEngine* engine;  // engine these kernels belong to, whose row and tile kernels the parallel tasks run
+    // Row buffers of width elements
+    int32_t* gradient;
+    int32_t* edgeFromLeft;
+    int32_t* edgeFromRight;
+};
+
+// Dp cells relaxed by one task of the tiled seam search. A band of rows is split into
+// trapezoids shrinking by one column per row on their inner sides, which only depend on the
+// row above the band, then the triangles left between them are filled. Row k of the band
+// (1 <= k <= rows) covers the columns [begin + (k - 1) * beginStep, end + (k - 1) * endStep).
+struct DpTile {
+    static constexpr int maxRows = 32;
+
+    void* dp;               // dp row k of the band starts at dp + k * dpStride costs, row 0 is the row above it
+    int dpStride;
+    int8_t* idx;            // back-pointers of row y start at idx + y * width
+    int firstRow;           // image row of band row 1
+    int rows;
+    int begin;
+    int end;
+    int beginStep;
+    int endStep;
+};
+
+enum class SeamIsa;
+
+// Entry points of one specialisation of the carving engine. Every combination of energy
+// metric, cost type, search mode, channel count and pixel layout is compiled with its own
+// fully inlined loops, selectSeamEngine() picks the one matching the settings at runtime.
+struct SeamEngine {
+    void (*computeEnergy)(const SeamContext& ctx);
+    void (*findSeam)(const SeamContext& ctx);
+    void (*findCheckpointedSeam)(const SeamContext& ctx);
+    // Remove ctx.seam from the pixels (or planes) and energy, the caller then decrements the width
+    void (*removeSeam)(const SeamContext& ctx);
+    // Remove ctx.seam, refresh the energy around it and find the next seam, fused into one
+    // sweep over the rows. The caller then decrements the width.
+    void (*removeAndFindSeam)(const SeamContext& ctx);
+    void (*removeAndFindCheckpointedSeam)(const SeamContext& ctx);
+    // Tasks of the parallel energy and tiled search, run on the shared Scheduler
+    void (*computeEnergyRows)(const SeamContext& ctx, int first, int last);
+    void (*dpTile)(const SeamContext& ctx, const DpTile& tile);
+    // Largest cost a single row can add to a seam
+    double maxStep;
+    // Rows and columns around a pixel its energy depends on
+    int energyRadius;
+    // Instruction set the entry points were compiled for
+    SeamIsa isa;
+};
+
+// Instruction sets the engine is compiled for, each in a translation unit of its own. The best
+// one supported by the CPU is picked on first use, the SEAMCARVING_ISA environment variable
+// (generic, sse4.2, avx2 or avx512) overrides it. Only the hot specialisations are compiled for
+// the other instruction sets than the generic one, see selectHotVariantEngine().
+enum class SeamIsa {
+    Generic,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+SeamIsa seamEngineIsa();
+// Instruction set of the engine carving with `settings`: seamEngineIsa(), or generic for the
+// specialisations it does not have
+SeamIsa seamEngineIsa(const Settings& settings);
+const char* seamIsaName(SeamIsa isa);
+
+const SeamEngine& selectSeamEngine(const Settings& settings);
+
+// Mirror the pixels next to both ends of a row into its border
+template <typename T>
+void mirrorBorder(T* row, int width) {
+    int last = width - 1;
+    row[-1] = row[min(1, last)];
+    row[-2] = row[min(2, last)];
+    row[width] = row[max(last - 1, 0)];
+    row[width + 1] = row[max(last - 2, 0)];
+}
+
+#endif // SEAMENGINE_H
@@ -0,0 +1,11 @@
+#include "seamKernels.h"
+
+using namespace std;
+
+// The hot specialisations of the engine compiled for AVX2, see seamEngine.cpp
+
+#ifdef SEAM_MULTI_ISA
+const SeamEngine* selectAvx2Engine(const Settings& settings) {
+    return selectHotVariantEngine<AVX2Variant>(settings);
+}
+#endif
@@ -0,0 +1,11 @@
+#include "seamKernels.h"
+
+using namespace std;
+
+// The hot specialisations of the engine compiled for AVX-512, see seamEngine.cpp
+
+#ifdef SEAM_MULTI_ISA
+const SeamEngine* selectAvx512Engine(const Settings& settings) {
+    return selectHotVariantEngine<AVX512Variant>(settings);
+}
+#endif
@@ -0,0 +1,11 @@
+#include "seamKernels.h"
+
+using namespace std;
+
+// The hot specialisations of the engine compiled for SSE4.2, see seamEngine.cpp
+
+#ifdef SEAM_MULTI_ISA
+const SeamEngine* selectSse42Engine(const Settings& settings) {
+    return selectHotVariantEngine<SSE42Variant>(settings);
+}
+#endif
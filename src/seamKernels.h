@@ -0,0 +1,677 @@
+#ifndef SEAMKERNELS_H
+#define SEAMKERNELS_H
+
+// Kernels of the carving engine, shared by the translation units that instantiate them for
+// each instruction set (seamEngine.cpp for the generic build, seamEngineSse42.cpp,
+// seamEngineAvx2.cpp and seamEngineAvx512.cpp).
+
+#include "seamEngine.h"
+#include "energyKernels.h"
+#include "scheduler.h"
+
+#include <type_traits>
+
+// Search mode policies
+struct BackwardSearch {};
+struct ForwardSearch {};
+
+// Pixel layout policies: how the kernels read rows and remove the seam pixel from them
+
+// Interleaved RGBA rows, the layout of SeamCarving::m_data
+struct InterleavedLayout {
+    using Row = InterleavedRow;
+
+    static Row row(const SeamContext& ctx, int y) {
+        return Row{ctx.pixels + static_cast<size_t>(y) * ctx.stride};
+    }
+
+    static void removeFromRow(const SeamContext& ctx, int y) {
+        int seam_x = ctx.seam[y];
+        Pixel* data_row = ctx.pixels + static_cast<size_t>(y) * ctx.stride;
+        copy(data_row + seam_x + 1, data_row + ctx.width, data_row + seam_x);
+        mirrorBorder(data_row, ctx.width - 1);
+    }
+};
+
+// One plane per channel, the interleaved rows are only rebuilt once carving is done
+struct PlanarLayout {
+    using Row = PlanarRow;
+
+    static uint8_t* plane(const SeamContext& ctx, int c, int y) {
+        return ctx.planes + (static_cast<size_t>(c) * ctx.height + y) * ctx.planeStride;
+    }
+
+    static Row row(const SeamContext& ctx, int y) {
+        return Row{plane(ctx, 0, y), plane(ctx, 1, y), plane(ctx, 2, y), plane(ctx, 3, y)};
+    }
+
+    static void removeFromRow(const SeamContext& ctx, int y) {
+        int seam_x = ctx.seam[y];
+        for (int c = 0; c < 4; ++c) {
+            uint8_t* data_row = plane(ctx, c, y);
+            copy(data_row + seam_x + 1, data_row + ctx.width, data_row + seam_x);
+            mirrorBorder(data_row, ctx.width - 1);
+        }
+    }
+};
+
+// Luminance plane, and alpha plane when it counts in the energy, carved along with the
+// interleaved pixels: the energy only reads the planes
+template <int Channels>
+struct LuminanceLayout {
+    using Row = LuminanceRow;
+
+    static uint8_t* plane(const SeamContext& ctx, int c, int y) {
+        return ctx.planes + (static_cast<size_t>(c) * ctx.height + y) * ctx.planeStride;
+    }
+
+    static Row row(const SeamContext& ctx, int y) {
+        return Row{plane(ctx, 0, y), plane(ctx, Channels == 4 ? 1 : 0, y)};
+    }
+
+    static void removeFromRow(const SeamContext& ctx, int y) {
+        InterleavedLayout::removeFromRow(ctx, y);
+        int seam_x = ctx.seam[y];
+        for (int c = 0; c < (Channels == 4 ? 2 : 1); ++c) {
+            uint8_t* data_row = plane(ctx, c, y);
+            copy(data_row + seam_x + 1, data_row + ctx.width, data_row + seam_x);
+            mirrorBorder(data_row, ctx.width - 1);
+        }
+    }
+};
+
+template <typename Metric, typename Cost, typename Search, typename Layout>
+struct SeamKernels {
+    using Traits = CostTraits<Cost>;
+    static constexpr bool forward = is_same_v<Search, ForwardSearch>;
+
+    static typename Layout::Row pixelRow(const SeamContext& ctx, int y) {
+        return Layout::row(ctx, y);
+    }
+
+    static Cost* energyRow(const SeamContext& ctx, int y) {
+        return static_cast<Cost*>(ctx.energy) + static_cast<size_t>(y) * ctx.stride;
+    }
+
+    // Row y + offset of a window, reflected inside the image like the columns of the borders
+    static int windowRow(const SeamContext& ctx, int y, int offset) {
+        int row = abs(y + offset);
+        if (row > ctx.height - 1) {
+            row = max(2 * (ctx.height - 1) - row, 0);
+        }
+        return row;
+    }
+
+    // Energy of the pixels [begin, end) of row y, based on the color gradient
+    static void energyRange(const SeamContext& ctx, int y, int begin, int end) {
+        Cost* row = energyRow(ctx, y);
+
+        if constexpr (Metric::windowed) {
+            typename Layout::Row rows[2 * Metric::radius + 1];
+            for (int k = 0; k <= 2 * Metric::radius; ++k) {
+                rows[k] = pixelRow(ctx, windowRow(ctx, y, k - Metric::radius));
+            }
+            Metric::windowRow(rows, begin, end, ctx.gradient);
+        } else {
+            // There is no vertical gradient on the first and last rows
+            bool inner_y = y > 0 && y < ctx.height - 1;
+            auto up = pixelRow(ctx, inner_y ? y - 1 : y);
+            auto down = pixelRow(ctx, inner_y ? y + 1 : y);
+            gradientRow<Metric>(up, pixelRow(ctx, y), down, begin, end, ctx.gradient);
+        }
+
+        for (int x = begin; x < end; ++x) {
+            row[x] = Traits::fromReal(Metric::energy(ctx.gradient[x]), ctx.costScale);
+        }
+    }
+
+    static void computeEnergyRows(const SeamContext& ctx, int first, int last) {
+        for (int y = first; y < last; ++y) {
+            energyRange(ctx, y, 0, ctx.width);
+        }
+    }
+
+    // Rows handed to one task of the parallel energy computation
+    static constexpr int energyGrain = 16;
+
+    // Compute energy for each pixel based on the color gradient
+    static void computeEnergy(const SeamContext& ctx) {
+        if (ctx.threads <= 1) {
+            computeEnergyRows(ctx, 0, ctx.height);
+            return;
+        }
+
+        // The row kernels come from the engine of the selected instruction set
+        const SeamEngine& kernels = *ctx.engine;
+        Scheduler::shared().parallelFor(0, ctx.height, energyGrain, [&](int first, int last) {
+            vector<int32_t> gradient(ctx.width);
+            SeamContext task = ctx;
+            task.gradient = gradient.data();
+            kernels.computeEnergyRows(task, first, last);
+        });
+    }
+
+    // Remove the seam pixel from row y of the pixels and energy
+    static void removeFromRow(const SeamContext& ctx, int y) {
+        int seam_x = ctx.seam[y];
+        Cost* energy_row = energyRow(ctx, y);
+        copy(energy_row + seam_x + 1, energy_row + ctx.width, energy_row + seam_x);
+        Layout::removeFromRow(ctx, y);
+    }
+
+    // Once ctx.seam is removed, only the pixels whose neighbours changed need a new energy:
+    // those up to the radius of the metric on each side of the seam, and those between the
+    // seam columns of the rows within the radius above and below.
+    // `ctx` has the width after the removal.
+    static void updateEnergyRow(const SeamContext& ctx, int y) {
+        const int32_t* seam = ctx.seam;
+        int first = seam[y];
+        int last = seam[y];
+        for (int r = max(y - Metric::radius, 0); r <= min(y + Metric::radius, ctx.height - 1); ++r) {
+            first = min(first, seam[r]);
+            last = max(last, seam[r]);
+        }
+        energyRange(ctx, y, max(first - Metric::radius, 0), min(last + Metric::radius, ctx.width));
+    }
+
+    // Nothing to do before the dp row of a plain search
+    struct NoRowUpdate {
+        void operator()(int) const {}
+    };
+
+    // Removes the previous seam from the rows and refreshes their energy just before the
+    // dp needs them, so that each row is loaded once per seam instead of once per pass.
+    // Energy row y needs the pixel rows around it, the removal runs the radius of the metric ahead.
+    struct FusedRowUpdate {
+        const SeamContext& before;  // width before the removal
+        const SeamContext& after;   // width after the removal
+        int removed = 0;            // rows the seam is already removed from
+
+        void operator()(int y) {
+            int needed = min(y + Metric::radius, before.height - 1);
+            for (; removed <= needed; ++removed) {
+                removeFromRow(before, removed);
+            }
+            updateEnergyRow(after, y);
+        }
+    };
+
+    // dp row of the given width, between two infinite cells
+    static Cost* takeDpRow(const SeamContext& ctx) {
+        Cost* row = ctx.scratch->take<Cost>(ctx.width + 2) + 1;
+        row[-1] = row[ctx.width] = Traits::infinity();
+        return row;
+    }
+
+    // Initial row of the dynamic programming table
+    static void dpFirstRow(const SeamContext& ctx, Cost* row) {
+        if constexpr (forward) {
+            fill(row, row + ctx.width, Cost());
+        } else {
+            const Cost* energy = energyRow(ctx, 0);
+            copy(energy, energy + ctx.width, row);
+        }
+    }
+
+    // Lowest cost to reach the pixels [begin, end) of row y, considering only the energy of the pixels on the path.
+    // The dp rows have one infinite cell on each side, so the three candidates need no bounds check.
+    // The back-pointers are the offset (-1, 0 or 1) of the column of the row above the path comes from.
+    static void backwardRow(const SeamContext& ctx, int y, const Cost* above, Cost* row, int8_t* idx, int begin, int end) {
+        const Cost* energy = energyRow(ctx, y);
+        for (int x = begin; x < end; ++x) {
+            Cost v = energy[x];
+            Cost min_val = above[x];
+            int8_t min_step = 0;
+            if (above[x - 1] < min_val) {
+                min_val = above[x - 1];
+                min_step = -1;
+            }
+            if (above[x + 1] < min_val) {
+                min_val = above[x + 1];
+                min_step = 1;
+            }
+
+            row[x] = Traits::add(min_val, v);
+            idx[x] = min_step;
+        }
+    }
+
+    // Lowest cost to reach the pixels [begin, end) of row y, including the energy of the edges created when the seam is removed
+    static void forwardRow(const SeamContext& ctx, int y, const Cost* above, Cost* row, int8_t* idx, int begin, int end) {
+        const Cost* energy = energyRow(ctx, y);
+        seamEdgeRow<Metric>(pixelRow(ctx, y - 1), pixelRow(ctx, y), begin, end, ctx.edgeFromLeft, ctx.edgeFromRight);
+
+        for (int x = begin; x < end; ++x) {
+            // Coming from the left neighbour of the row above
+            Cost min_val = Traits::add(above[x - 1], Traits::fromReal(ctx.edgeFromLeft[x], ctx.costScale));
+            int8_t min_step = -1;
+
+            Cost val = Traits::add(above[x], energy[x]);
+            if (val < min_val) {
+                min_val = val;
+                min_step = 0;
+            }
+
+            // Coming from the right neighbour of the row above
+            val = Traits::add(above[x + 1], Traits::fromReal(ctx.edgeFromRight[x], ctx.costScale));
+            if (val < min_val) {
+                min_val = val;
+                min_step = 1;
+            }
+
+            row[x] = min_val;
+            idx[x] = min_step;
+        }
+    }
+
+    static void dpRow(const SeamContext& ctx, int y, const Cost* above, Cost* row, int8_t* idx, int begin, int end) {
+        if constexpr (forward) {
+            forwardRow(ctx, y, above, row, idx, begin, end);
+        } else {
+            backwardRow(ctx, y, above, row, idx, begin, end);
+        }
+    }
+
+    static void dpRow(const SeamContext& ctx, int y, const Cost* above, Cost* row, int8_t* idx) {
+        dpRow(ctx, y, above, row, idx, 0, ctx.width);
+    }
+
+    static void dpTile(const SeamContext& ctx, const DpTile& tile) {
+        Cost* dp = static_cast<Cost*>(tile.dp);
+        for (int k = 1; k <= tile.rows; ++k) {
+            int y = tile.firstRow + k - 1;
+            int begin = tile.begin + (k - 1) * tile.beginStep;
+            int end = tile.end + (k - 1) * tile.endStep;
+            dpRow(ctx, y, dp + static_cast<size_t>(k - 1) * tile.dpStride, dp + static_cast<size_t>(k) * tile.dpStride,
+                  &tile.idx[static_cast<size_t>(y) * ctx.width], begin, end);
+        }
+    }
+
+    // Column of the cheapest seam given the last row of the dp table
+    static int seamEnd(const SeamContext& ctx, const Cost* last) {
+        Cost min_path_cost = Traits::infinity();
+        int seam_end_x = 0;
+        for (int x = 0; x < ctx.width; ++x) {
+            if (last[x] < min_path_cost) {
+                min_path_cost = last[x];
+                seam_end_x = x;
+            }
+        }
+        return seam_end_x;
+    }
+
+    // The dynamic programming table (dp) stores the lowest energy cost to reach each pixel
+    // It also keeps track of the path that led to this lowest cost (dp_idx)
+    // Only two rows of dp are needed at a time, dp_idx is kept for the whole image.
+    // update(y) is called before row y is first read.
+    template <typename RowUpdate>
+    static void searchSeam(const SeamContext& ctx, RowUpdate update) {
+        int width = ctx.width;
+        int tiles = ctx.threads;
+        int band = min(DpTile::maxRows, width / (2 * max(tiles, 1)));
+        if (tiles > 1 && band >= minTiledRows && ctx.height > 1) {
+            searchTiledSeam(ctx, update, tiles, band);
+            return;
+        }
+
+        ctx.scratch->reset();
+        Cost* above = takeDpRow(ctx);
+        Cost* row = takeDpRow(ctx);
+        int8_t* dp_idx = ctx.backPointers ? ctx.backPointers : ctx.scratch->take<int8_t>(static_cast<size_t>(width) * ctx.height);
+
+        update(0);
+        dpFirstRow(ctx, above);
+        for (int y = 1; y < ctx.height; ++y) {
+            update(y);
+            dpRow(ctx, y, above, row, &dp_idx[static_cast<size_t>(y) * width]);
+            swap(above, row);
+        }
+
+        int x = seamEnd(ctx, above);
+        for (int y = ctx.height - 1; y >= 0; --y) {
+            ctx.seam[y] = x;
+            x += dp_idx[static_cast<size_t>(y) * width + x];
+        }
+    }
+
+    // Bands thinner than this are not worth the synchronisation of the tiled search
+    static constexpr int minTiledRows = 4;
+
+    // searchSeam() split into `tiles` column tiles run in parallel, which only synchronise twice
+    // per band of `band` rows: after the trapezoids and after the triangles between them.
+    // Each tile is at least 2 * band columns wide so that the trapezoids never get empty.
+    template <typename RowUpdate>
+    static void searchTiledSeam(const SeamContext& ctx, RowUpdate& update, int tiles, int band) {
+        int width = ctx.width;
+        int dp_stride = width + 2;
+        ctx.scratch->reset();
+        Cost* dp = ctx.scratch->take<Cost>(static_cast<size_t>(band + 1) * dp_stride) + 1;
+        for (int k = 0; k <= band; ++k) {
+            dp[static_cast<size_t>(k) * dp_stride - 1] = dp[static_cast<size_t>(k) * dp_stride + width] = Traits::infinity();
+        }
+        int8_t* dp_idx = ctx.backPointers ? ctx.backPointers : ctx.scratch->take<int8_t>(static_cast<size_t>(width) * ctx.height);
+
+        update(0);
+        dpFirstRow(ctx, dp);
+
+        // The tile kernels come from the engine of the selected instruction set
+        const SeamEngine& kernels = *ctx.engine;
+        Scheduler& scheduler = Scheduler::shared();
+        int rows = 0;
+        for (int first = 1; first < ctx.height; first += rows) {
+            if (rows > 0) {
+                Cost* last_row = dp + static_cast<size_t>(rows) * dp_stride;
+                copy(last_row, last_row + width, dp);
+            }
+            rows = min(band, ctx.height - first);
+            for (int y = first; y < first + rows; ++y) {
+                update(y);
+            }
+
+            // Tile t covers [t * width / tiles, (t + 1) * width / tiles), the image borders do not shrink
+            auto boundary_of = [&](int t) { return static_cast<int>(static_cast<int64_t>(t) * width / tiles); };
+            scheduler.parallelFor(0, tiles, 1, [&](int t, int) {
+                DpTile trapezoid{dp, dp_stride, dp_idx, first, rows,
+                                 boundary_of(t), boundary_of(t + 1),
+                                 t == 0 ? 0 : 1, t == tiles - 1 ? 0 : -1};
+                kernels.dpTile(ctx, trapezoid);
+            });
+
+            // Then the triangles growing from the boundaries between tiles
+            scheduler.parallelFor(1, tiles, 1, [&](int t, int) {
+                int boundary = boundary_of(t);
+                DpTile triangle{dp, dp_stride, dp_idx, first, rows, boundary, boundary, -1, 1};
+                kernels.dpTile(ctx, triangle);
+            });
+        }
+
+        int x = seamEnd(ctx, dp + static_cast<size_t>(rows) * dp_stride);
+        for (int y = ctx.height - 1; y >= 0; --y) {
+            ctx.seam[y] = x;
+            x += dp_idx[static_cast<size_t>(y) * width + x];
+        }
+    }
+
+    // Only one dp row every `step` rows is kept during the forward sweep (the checkpoints).
+    // While backtracking, the rows between two checkpoints are recomputed from the upper one,
+    // this time keeping their back-pointers, so that the seam can be followed through them.
+    // update(y) is called before row y is first read, by the forward sweep.
+    template <typename RowUpdate>
+    static void searchCheckpointedSeam(const SeamContext& ctx, RowUpdate update) {
+        int width = ctx.width;
+        int step = ctx.checkpointStep;
+        int num_checkpoints = (ctx.height - 1) / step + 1;
+
+        ctx.scratch->reset();
+        Cost* checkpoints = ctx.scratch->take<Cost>(static_cast<size_t>(num_checkpoints) * width);
+        Cost* above = takeDpRow(ctx);
+        Cost* row = takeDpRow(ctx);
+        int8_t* idx = ctx.scratch->take<int8_t>(static_cast<size_t>(step) * width);
+
+        update(0);
+        dpFirstRow(ctx, above);
+        copy(above, above + width, checkpoints);
+        for (int y = 1; y < ctx.height; ++y) {
+            update(y);
+            dpRow(ctx, y, above, row, idx);
+            swap(above, row);
+            if (y % step == 0) {
+                copy(above, above + width, &checkpoints[static_cast<size_t>(y / step) * width]);
+            }
+        }
+
+        int x = seamEnd(ctx, above);
+        for (int c = num_checkpoints - 1; c >= 0; --c) {
+            // Recompute rows first..last, which all depend on the checkpoint row first - 1
+            int first = c * step + 1;
+            int last = min(first + step - 1, ctx.height - 1);
+
+            copy(&checkpoints[static_cast<size_t>(c) * width], &checkpoints[static_cast<size_t>(c + 1) * width], above);
+            for (int y = first; y <= last; ++y) {
+                dpRow(ctx, y, above, row, &idx[static_cast<size_t>(y - first) * width]);
+                swap(above, row);
+            }
+
+            for (int y = last; y >= first; --y) {
+                ctx.seam[y] = x;
+                x += idx[static_cast<size_t>(y - first) * width + x];
+            }
+        }
+        ctx.seam[0] = x;
+    }
+
+    static void findSeam(const SeamContext& ctx) {
+        searchSeam(ctx, NoRowUpdate());
+    }
+
+    static void findCheckpointedSeam(const SeamContext& ctx) {
+        searchCheckpointedSeam(ctx, NoRowUpdate());
+    }
+
+    // Remove the pixel of the seam from every row of the pixels and energy
+    static void removeSeam(const SeamContext& ctx) {
+        SeamContext after = ctx;
+        after.width = ctx.width - 1;
+        FusedRowUpdate update{ctx, after};
+        for (int y = 0; y < ctx.height; ++y) {
+            update(y);
+        }
+    }
+
+    // Remove ctx.seam and search the next one in a single sweep over the rows
+    static void removeAndFindSeam(const SeamContext& ctx) {
+        SeamContext after = ctx;
+        after.width = ctx.width - 1;
+        searchSeam(after, FusedRowUpdate{ctx, after});
+    }
+
+    static void removeAndFindCheckpointedSeam(const SeamContext& ctx) {
+        SeamContext after = ctx;
+        after.width = ctx.width - 1;
+        searchCheckpointedSeam(after, FusedRowUpdate{ctx, after});
+    }
+
+    static double maxStep() {
+        return forward ? max(Metric::maxEnergy(), Metric::maxDiff()) : Metric::maxEnergy();
+    }
+
+    static constexpr int radius = Metric::radius;
+};
+
+// Entry points of K compiled for the target of the compiler
+template <typename K>
+using GenericVariant = K;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SEAM_MULTI_ISA 1
+
+// Entry points of K compiled for another instruction set. flatten inlines the whole call tree
+// into each wrapper, so every loop of the engine is generated for the target.
+#define SEAM_ISA_VARIANT(Name, Target) \
+    template <typename K> \
+    struct Name { \
+        __attribute__((target(Target), flatten)) static void computeEnergy(const SeamContext& ctx) { K::computeEnergy(ctx); } \
+        __attribute__((target(Target), flatten)) static void findSeam(const SeamContext& ctx) { K::findSeam(ctx); } \
+        __attribute__((target(Target), flatten)) static void findCheckpointedSeam(const SeamContext& ctx) { K::findCheckpointedSeam(ctx); } \
+        __attribute__((target(Target), flatten)) static void removeSeam(const SeamContext& ctx) { K::removeSeam(ctx); } \
+        __attribute__((target(Target), flatten)) static void removeAndFindSeam(const SeamContext& ctx) { K::removeAndFindSeam(ctx); } \
+        __attribute__((target(Target), flatten)) static void removeAndFindCheckpointedSeam(const SeamContext& ctx) { K::removeAndFindCheckpointedSeam(ctx); } \
+        __attribute__((target(Target), flatten)) static void computeEnergyRows(const SeamContext& ctx, int first, int last) { K::computeEnergyRows(ctx, first, last); } \
+        __attribute__((target(Target), flatten)) static void dpTile(const SeamContext& ctx, const DpTile& tile) { K::dpTile(ctx, tile); } \
+    };
+
+SEAM_ISA_VARIANT(SSE42Variant, "sse4.2")
+SEAM_ISA_VARIANT(AVX2Variant, "avx2,fma")
+SEAM_ISA_VARIANT(AVX512Variant, "avx512f,avx512bw,avx512vl")
+
+#endif
+
+// Instruction set of each variant
+template <template <typename> class Variant>
+constexpr SeamIsa variantIsa = SeamIsa::Generic;
+
+#ifdef SEAM_MULTI_ISA
+template <>
+constexpr SeamIsa variantIsa<SSE42Variant> = SeamIsa::SSE42;
+template <>
+constexpr SeamIsa variantIsa<AVX2Variant> = SeamIsa::AVX2;
+template <>
+constexpr SeamIsa variantIsa<AVX512Variant> = SeamIsa::AVX512;
+#endif
+
+template <typename V>
+SeamEngine makeEngine(double max_step, int energy_radius, SeamIsa isa) {
+    return SeamEngine{&V::computeEnergy, &V::findSeam, &V::findCheckpointedSeam, &V::removeSeam,
+                      &V::removeAndFindSeam, &V::removeAndFindCheckpointedSeam,
+                      &V::computeEnergyRows, &V::dpTile, max_step, energy_radius, isa};
+}
+
+// Engine of the kernels K wrapped by Variant, one of the instruction sets
+template <template <typename> class Variant, typename K>
+const SeamEngine& variantEngine() {
+    static const SeamEngine engine = makeEngine<Variant<K>>(K::maxStep(), K::radius, variantIsa<Variant>);
+    return engine;
+}
+
+// Runtime dispatch, one level per policy
+
+// Layout computing the energy of a metric from the luminance plane, void for the metrics that
+// need the colours
+template <typename Metric>
+struct LuminancePlaneLayout {
+    using type = void;
+};
+
+template <int Channels>
+struct LuminancePlaneLayout<LuminanceMetric<Channels>> {
+    using type = LuminanceLayout<Channels>;
+};
+
+template <int Channels, int Side, int Center>
+struct LuminancePlaneLayout<DerivativeMetric<Channels, Side, Center>> {
+    using type = LuminanceLayout<Channels>;
+};
+
+template <int Channels>
+struct LuminancePlaneLayout<EntropyMetric<Channels>> {
+    using type = LuminanceLayout<Channels>;
+};
+
+template <int Channels>
+struct LuminancePlaneLayout<HogMetric<Channels>> {
+    using type = LuminanceLayout<Channels>;
+};
+
+template <template <typename> class Variant, typename Metric, typename Cost, typename Search>
+const SeamEngine& selectLayout(const Settings& settings) {
+    using LumaLayout = typename LuminancePlaneLayout<Metric>::type;
+    // The window operators only read the luminance, they are not compiled for the other layouts
+    if constexpr (Metric::windowed) {
+        return variantEngine<Variant, SeamKernels<Metric, Cost, Search, LumaLayout>>();
+    } else {
+        if constexpr (!is_void_v<LumaLayout>) {
+            if (settings.usesLuminancePlane()) {
+                return variantEngine<Variant, SeamKernels<Metric, Cost, Search, LumaLayout>>();
+            }
+        }
+        if (settings.planarLayout) {
+            return variantEngine<Variant, SeamKernels<Metric, Cost, Search, PlanarLayout>>();
+        }
+        return variantEngine<Variant, SeamKernels<Metric, Cost, Search, InterleavedLayout>>();
+    }
+}
+
+template <template <typename> class Variant, typename Metric, typename Cost>
+const SeamEngine& selectSearch(const Settings& settings) {
+    if (settings.doBackwardSearch) {
+        return selectLayout<Variant, Metric, Cost, BackwardSearch>(settings);
+    }
+    return selectLayout<Variant, Metric, Cost, ForwardSearch>(settings);
+}
+
+template <template <typename> class Variant, typename Metric>
+const SeamEngine& selectCost(const Settings& settings) {
+    switch (settings.costType) {
+        case CostType::Float:
+            return selectSearch<Variant, Metric, float>(settings);
+        case CostType::Fixed:
+            return selectSearch<Variant, Metric, uint32_t>(settings);
+        default:
+            return selectSearch<Variant, Metric, double>(settings);
+    }
+}
+
+template <template <typename> class Variant, int Channels>
+const SeamEngine& selectMetric(const Settings& settings) {
+    switch (settings.energyMetric) {
+        case EnergyMetric::L2Squared:
+            return selectCost<Variant, L2SquaredMetric<Channels>>(settings);
+        case EnergyMetric::L1:
+            return selectCost<Variant, L1Metric<Channels>>(settings);
+        case EnergyMetric::Luminance:
+            return selectCost<Variant, LuminanceMetric<Channels>>(settings);
+        case EnergyMetric::Sobel:
+            return selectCost<Variant, SobelMetric<Channels>>(settings);
+        case EnergyMetric::Scharr:
+            return selectCost<Variant, ScharrMetric<Channels>>(settings);
+        case EnergyMetric::Entropy:
+            return selectCost<Variant, EntropyMetric<Channels>>(settings);
+        case EnergyMetric::HogWeighted:
+            return selectCost<Variant, HogMetric<Channels>>(settings);
+        default:
+            return selectCost<Variant, L2Metric<Channels>>(settings);
+    }
+}
+
+// Every specialisation of the engine compiled by Variant
+template <template <typename> class Variant>
+const SeamEngine& selectVariantEngine(const Settings& settings) {
+    if (settings.alphaInEnergy) {
+        return selectMetric<Variant, 4>(settings);
+    }
+    return selectMetric<Variant, 3>(settings);
+}
+
+template <template <typename> class Variant, typename Metric, typename Layout>
+const SeamEngine* selectHotCost(const Settings& settings) {
+    bool fixed = settings.costType == CostType::Fixed;
+    if (settings.doBackwardSearch) {
+        return fixed ? &variantEngine<Variant, SeamKernels<Metric, uint32_t, BackwardSearch, Layout>>() :
+                       &variantEngine<Variant, SeamKernels<Metric, double, BackwardSearch, Layout>>();
+    }
+    return fixed ? &variantEngine<Variant, SeamKernels<Metric, uint32_t, ForwardSearch, Layout>>() :
+                   &variantEngine<Variant, SeamKernels<Metric, double, ForwardSearch, Layout>>();
+}
+
+// The specialisations worth compiling for the other instruction sets: the L2 metric on the
+// interleaved pixels and the Luminance metric on them or on the luminance plane, in double or
+// fixed-point costs, without alpha. nullptr for the others, which run the generic engine.
+template <template <typename> class Variant>
+const SeamEngine* selectHotVariantEngine(const Settings& settings) {
+    if (settings.alphaInEnergy || settings.costType == CostType::Float) {
+        return nullptr;
+    }
+    switch (settings.energyMetric) {
+        case EnergyMetric::L2:
+            return settings.planarLayout ? nullptr : selectHotCost<Variant, L2Metric<3>, InterleavedLayout>(settings);
+        case EnergyMetric::Luminance:
+            if (settings.usesLuminancePlane()) {
+                return selectHotCost<Variant, LuminanceMetric<3>, LuminanceLayout<3>>(settings);
+            }
+            return settings.planarLayout ? nullptr :
+                                           selectHotCost<Variant, LuminanceMetric<3>, InterleavedLayout>(settings);
+        default:
+            return nullptr;
+    }
+}
+
+// Engines of each instruction set, each one compiled in a translation unit of its own. Only the
+// generic one has every specialisation, the others return nullptr for the ones they do not have.
+const SeamEngine& selectGenericEngine(const Settings& settings);
+#ifdef SEAM_MULTI_ISA
+const SeamEngine* selectSse42Engine(const Settings& settings);
+const SeamEngine* selectAvx2Engine(const Settings& settings);
+const SeamEngine* selectAvx512Engine(const Settings& settings);
+#endif
+
+#endif // SEAMKERNELS_H
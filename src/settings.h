@@ -1,15 +1,84 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <cstddef>
+#include <string>
+
+// Number type of the energy map and of the seam search costs
+enum class CostType {
+    Double,
+    Float,
+    Fixed   // saturating 32 bits fixed-point
+};
+
+// Formula turning the colour gradient of a pixel into its energy
+enum class EnergyMetric {
+    L2,         // sqrt(dx^2 + dy^2) over the RGB channels
+    L2Squared,  // dx^2 + dy^2 over the RGB channels
+    L1,         // |dx| + |dy| over the RGB channels
+    Luminance,  // |dx| + |dy| over the luminance only
+    // Operators of the luminance over a window of pixels
+    Sobel,      // L2 norm of the 3x3 Sobel derivatives
+    Scharr,     // L2 norm of the 3x3 Scharr derivatives, more isotropic
+    Entropy,    // |dx| + |dy| plus the entropy of the 5x5 pixels around
+    HogWeighted // |dx| + |dy| divided by the largest bin of the 3x3 histogram of gradient orientations
+};
+
 class Settings {
     public:
         bool doBackwardSearch;
         bool showEnergy;
         int seamsToRemove;
+        // Maximum size in bytes of the dp/dp_idx tables used by the seam search.
+        // Above it the checkpointed search is used instead. 0 means no limit.
+        size_t dpMemoryBudget = 0;
+        // Maximum size in bytes of all the buffers of a SeamCarving. The seam search gets what
+        // the image, its energy and the seams leave, and is checkpointed when its full tables
+        // do not fit. The image itself is never refused. 0 means no limit.
+        size_t memoryBudget = 0;
+        CostType costType = CostType::Double;
+        EnergyMetric energyMetric = EnergyMetric::L2;
+        // Also count alpha differences in the energy
+        bool alphaInEnergy = false;
+        // Carve a copy of the image stored as one plane per channel, for faster SIMD loads
+        bool planarLayout = false;
+        // With the Luminance metric, convert the pixels to a luminance plane once and keep it
+        // carved along with them: the energy updates then read one byte per pixel instead of
+        // converting three channels for every difference. The energies are the same; it takes
+        // over planarLayout. The window operators always read such a plane.
+        bool luminancePlane = false;
+        // Parallel tasks of the energy and seam search, run on the shared Scheduler. Above 1 the dp
+        // is split into tiles of rows and columns; the checkpointed search always runs serially.
+        int seamThreads = 1;
+        // Keep the pixels, planes and energy in temporary files mapped in memory, for images larger
+        // than the RAM: the system pages their rows in and out as the sweeps go down the image.
+        // The back-pointers of a seam search over the budgets go to such a file too, instead of
+        // falling back to the checkpointed search. A PixelBuffer is still carved where it is.
+        bool outOfCore = false;
+        // Directory of the temporary files, TMPDIR (or /tmp) when empty
+        std::string spillDirectory;
+        // Operators of a window of the luminance, rather than of the differences with the neighbours
+        bool usesWindowMetric() const {
+            return energyMetric == EnergyMetric::Sobel || energyMetric == EnergyMetric::Scharr ||
+                   energyMetric == EnergyMetric::Entropy || energyMetric == EnergyMetric::HogWeighted;
+        }
+        bool usesLuminancePlane() const {
+            return usesWindowMetric() || (luminancePlane && energyMetric == EnergyMetric::Luminance);
+        }
         bool isEqual(const Settings &other) {
             return (other.doBackwardSearch == doBackwardSearch &&
                     other.showEnergy == showEnergy &&
-                    other.seamsToRemove == seamsToRemove);
+                    other.seamsToRemove == seamsToRemove &&
+                    other.dpMemoryBudget == dpMemoryBudget &&
+                    other.memoryBudget == memoryBudget &&
+                    other.costType == costType &&
+                    other.energyMetric == energyMetric &&
+                    other.alphaInEnergy == alphaInEnergy &&
+                    other.planarLayout == planarLayout &&
+                    other.luminancePlane == luminancePlane &&
+                    other.seamThreads == seamThreads &&
+                    other.outOfCore == outOfCore &&
+                    other.spillDirectory == spillDirectory);
         };
 };
 
@@ -0,0 +1,217 @@
+// Benchmarks of the carving engine on synthetic images, see printUsage()
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "qoiCodec.h"
+#include "scheduler.h"
+#include "seamEngine.h"
+#include "testUtils.h"
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct BenchOptions {
+    int width = 1600;
+    int height = 1000;
+    int seams = 100;
+    // Runs of each configuration, the fastest one is reported
+    int repeats = 3;
+    bool costs = false;
+    bool threads = false;
+    // Megapixels of the out of core benchmark, 0 when not run
+    int largeMegapixels = 0;
+};
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Time the carving of synthetic images, every benchmark but --large when none is selected\n"
+            "\n"
+            "      --costs            double, float and fixed-point costs, and whether their seams match\n"
+            "      --threads          tiled seam search on 1, 2, 4... threads, up to the scheduler size\n"
+            "      --large [MP]       out of core carving of an image of MP megapixels (default: 1000),\n"
+            "                         decoded from a QOI file and spilled to TMPDIR; --seams sets its seams\n"
+            "      --size WxH         image size (default: 1600x1000)\n"
+            "      --seams N          seams removed by each run (default: 100)\n"
+            "      --repeats N        runs of each configuration, the fastest is reported (default: 3)\n",
+            program);
+}
+
+// Fastest of the runs carving `seams` seams, the seams of the last one in `seams_found`
+static double timeCarve(const SyntheticImage& image, const Settings& settings, const BenchOptions& options,
+                        vector<int32_t>* seams_found = nullptr) {
+    double best = 0;
+    for (int run = 0; run < options.repeats; ++run) {
+        SeamCarving carving(image.view(), settings);
+        Clock::time_point start = Clock::now();
+        carving.carve(options.seams);
+        double seconds = secondsSince(start);
+        best = run == 0 ? seconds : min(best, seconds);
+        if (seams_found && run == options.repeats - 1) {
+            *seams_found = removedSeams(carving);
+        }
+    }
+    return best;
+}
+
+static void benchCosts(const SyntheticImage& image, const BenchOptions& options) {
+    printf("\ncost types, %d seams of %dx%d\n", options.seams, image.width, image.height);
+    const pair<const char*, CostType> costs[] = {
+        {"double", CostType::Double}, {"float", CostType::Float}, {"fixed", CostType::Fixed}};
+    for (bool backward : {true, false}) {
+        vector<int32_t> reference;
+        double reference_seconds = 0;
+        for (const auto& cost : costs) {
+            Settings settings = testSettings();
+            settings.doBackwardSearch = backward;
+            settings.costType = cost.second;
+            vector<int32_t> seams;
+            double seconds = timeCarve(image, settings, options, &seams);
+            if (cost.second == CostType::Double) {
+                reference = seams;
+                reference_seconds = seconds;
+            }
+            printf("  %-8s %-6s %8.1f ms  %5.2fx  seams %s\n", backward ? "backward" : "forward", cost.first,
+                   1000.0 * seconds, reference_seconds / seconds, seams == reference ? "match" : "DIFFER");
+        }
+    }
+}
+
+// The shared scheduler runs the tasks: its size (SEAMCARVING_THREADS) bounds the speedup
+static void benchThreads(const SyntheticImage& image, const BenchOptions& options) {
+    int pool = Scheduler::shared().threadCount();
+    printf("\nseam threads, %d seams of %dx%d, scheduler of %d threads\n", options.seams, image.width, image.height,
+           pool);
+    vector<int> counts;
+    for (int threads = 1; threads < max(pool, 2); threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(max(pool, 2));
+    for (bool backward : {true, false}) {
+        vector<int32_t> reference;
+        double reference_seconds = 0;
+        for (int threads : counts) {
+            Settings settings = testSettings();
+            settings.doBackwardSearch = backward;
+            settings.seamThreads = threads;
+            vector<int32_t> seams;
+            double seconds = timeCarve(image, settings, options, &seams);
+            if (threads == 1) {
+                reference = seams;
+                reference_seconds = seconds;
+            }
+            printf("  %-8s %2d threads %8.1f ms  %5.2fx  seams %s\n", backward ? "backward" : "forward", threads,
+                   1000.0 * seconds, reference_seconds / seconds, seams == reference ? "match" : "DIFFER");
+        }
+    }
+}
+
+static double mebibytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// The image is written to a QOI file row by row and carved with its buffers in temporary files:
+// neither step holds the whole image in memory
+static void benchLarge(const BenchOptions& options) {
+    // Same aspect ratio as the default size
+    double pixels = options.largeMegapixels * 1e6;
+    int width = static_cast<int>(min(sqrt(pixels * 1.6), static_cast<double>(maxImageSize)));
+    int height = static_cast<int>(min(pixels / width, static_cast<double>(maxImageSize)));
+    int seams = max(min(options.seams, width - 1), 0);
+    printf("\nout of core, %d seams of %dx%d (%.0f megapixels)\n", seams, width, height, 1e-6 * width * height);
+
+    TemporaryPath qoi("large.qoi");
+    Clock::time_point start = Clock::now();
+    QoiWriter writer;
+    vector<unsigned char> row(static_cast<size_t>(width) * 4);
+    bool written = writer.open(qoi.path, width, height);
+    for (int y = 0; written && y < height; ++y) {
+        syntheticRow(y, width, row.data());
+        written = writer.writeRow(row.data());
+    }
+    if (!writer.close() || !written) {
+        fprintf(stderr, "Couldn't write %s\n", qoi.path.c_str());
+        return;
+    }
+    printf("  write    %8.1f s\n", secondsSince(start));
+
+    Settings settings = testSettings();
+    settings.outOfCore = true;
+    settings.spillDirectory = temporaryDirectory();
+    start = Clock::now();
+    SeamCarving carving(qoi.path, settings);
+    printf("  load     %8.1f s\n", secondsSince(start));
+    start = Clock::now();
+    carving.carve(seams);
+    double seconds = secondsSince(start);
+    printf("  carve    %8.1f s  %8.1f ms/seam\n", seconds, seams > 0 ? 1000.0 * seconds / seams : 0.0);
+
+    MemoryStats memory = carving.getMemoryStats();
+    printf("  memory   %8.1f MiB peak in memory, %.1f MiB spilled\n", mebibytes(memory.peak),
+           mebibytes(memory.spilled));
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--costs") {
+            options.costs = true;
+        } else if (arg == "--threads") {
+            options.threads = true;
+        } else if (arg == "--large") {
+            options.largeMegapixels = 1000;
+            if (has_value && argv[i + 1][0] != '-') {
+                options.largeMegapixels = atoi(argv[++i]);
+            }
+            if (options.largeMegapixels < 1) {
+                fprintf(stderr, "Invalid size %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--size" && has_value) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width < 2 ||
+                options.height < 2) {
+                fprintf(stderr, "Invalid size %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--seams" && has_value) {
+            options.seams = atoi(argv[++i]);
+        } else if (arg == "--repeats" && has_value) {
+            options.repeats = max(atoi(argv[++i]), 1);
+        } else {
+            printUsage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 2;
+        }
+    }
+    if (!options.costs && !options.threads && options.largeMegapixels == 0) {
+        options.costs = options.threads = true;
+    }
+
+    printf("%s engine\n", seamIsaName(seamEngineIsa(testSettings())));
+    if (options.costs || options.threads) {
+        BenchOptions small = options;
+        small.seams = max(min(options.seams, options.width - 1), 0);
+        SyntheticImage image(options.width, options.height);
+        if (options.costs) {
+            benchCosts(image, small);
+        }
+        if (options.threads) {
+            benchThreads(image, small);
+        }
+    }
+    if (options.largeMegapixels > 0) {
+        benchLarge(options);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+// The seam removal loop reuses the buffers sized when the image is loaded: carving more seams
+// must not allocate more. Every allocation goes through the operator new replaced below.
+
+#include <cstdlib>
+#include <new>
+
+#include "testUtils.h"
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+using namespace std;
+
+// Allocations made by carve(num_seams) on a fresh image
+static size_t carveAllocations(const SyntheticImage& image, const Settings& settings, int num_seams) {
+    SeamCarving carving(image.view(), settings);
+    size_t before = allocations;
+    carving.carve(num_seams);
+    return allocations - before;
+}
+
+int main() {
+    SyntheticImage image(160, 96);
+    for (bool backward : {true, false}) {
+        for (CostType cost : {CostType::Double, CostType::Float, CostType::Fixed}) {
+            // Full tables, then the checkpointed search forced by a tiny budget
+            for (size_t budget : {size_t(0), size_t(1)}) {
+                for (int layout = 0; layout < 3; ++layout) {
+                    Settings settings = testSettings();
+                    settings.doBackwardSearch = backward;
+                    settings.costType = cost;
+                    settings.dpMemoryBudget = budget;
+                    settings.planarLayout = layout == 1;
+                    if (layout == 2) {
+                        settings.energyMetric = EnergyMetric::Luminance;
+                        settings.luminancePlane = true;
+                    }
+
+                    size_t one = carveAllocations(image, settings, 1);
+                    size_t many = carveAllocations(image, settings, 40);
+                    if (many != one) {
+                        fprintf(stderr, "backward %d, cost %d, budget %zu, layout %d: %zu allocations for 1 seam, %zu for 40\n",
+                                backward, static_cast<int>(cost), budget, layout, one, many);
+                    }
+                    CHECK(many == one);
+                }
+            }
+        }
+    }
+    return testResult("allocations");
+}
@@ -0,0 +1,90 @@
+// SeamCarving seen from its public interface: carving, removed seams and snapshots
+
+#include "testUtils.h"
+
+using namespace std;
+
+// An image that could not be loaded is empty, and so are its seams
+static void testEmptyImage() {
+    SeamCarving carving("/nonexistent/image.png", testSettings());
+    CHECK(carving.getCarvedWidth() == 0);
+    CHECK(carving.getCarvedHeight() == 0);
+    CHECK(carving.getRemovedSeamCount() == 0);
+    CHECK(carving.getLastSeams(3).count == 0);
+
+    TemporaryPath raw("empty.scraw");
+    CHECK(carving.saveRawImageToFile(raw.path, true, true));
+}
+
+// The callback is given the width reached, once, even for widths the image is narrower than
+static void testCarveToWidths() {
+    SyntheticImage image(120, 50);
+    SeamCarving carving(image.view(), testSettings());
+    vector<int> reached;
+    carving.carveToWidths({200, 100, 130, 80, 80}, [&](int width, const SeamCarving& carved) {
+        CHECK(carved.getCarvedWidth() == width);
+        reached.push_back(width);
+    });
+    CHECK((reached == vector<int>{120, 100, 80}));
+
+    SeamCarving snapshots(image.view(), testSettings());
+    vector<CarvedImage> images = snapshots.carveToWidths({100, 200, 0});
+    CHECK(images.size() == 3);
+    CHECK(images[0].width == 100);
+    CHECK(images[1].width == 120);
+    CHECK(images[2].width == 1);
+}
+
+// BGRA and RGB views are converted to the RGBA pixels they hold, with padded rows
+static void testPixelFormats() {
+    SyntheticImage image(37, 11);
+    const size_t padding = 5;
+    vector<unsigned char> bgra(image.height * (image.width * 4 + padding));
+    vector<unsigned char> rgb(image.height * (image.width * 3 + padding));
+    for (int y = 0; y < image.height; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+            const unsigned char* p = &image.rgba[(static_cast<size_t>(y) * image.width + x) * 4];
+            unsigned char* q = &bgra[y * (image.width * 4 + padding) + x * 4];
+            q[0] = p[2];
+            q[1] = p[1];
+            q[2] = p[0];
+            q[3] = p[3];
+            unsigned char* r = &rgb[y * (image.width * 3 + padding) + x * 3];
+            r[0] = p[0];
+            r[1] = p[1];
+            r[2] = p[2];
+        }
+    }
+    // The synthetic pixels are opaque
+    CarvedImage expected = SeamCarving(image.view(), testSettings()).snapshot();
+    ImageView bgra_view{bgra.data(), image.width, image.height, image.width * 4 + padding, PixelFormat::BGRA};
+    CHECK(SeamCarving(bgra_view, testSettings()).snapshot().rgba == expected.rgba);
+    ImageView rgb_view{rgb.data(), image.width, image.height, image.width * 3 + padding, PixelFormat::RGB};
+    CHECK(SeamCarving(rgb_view, testSettings()).snapshot().rgba == expected.rgba);
+}
+
+// Negative counts remove nothing, too large ones leave a single column
+static void testSeamCountClamped() {
+    SyntheticImage image(30, 20);
+    SeamCarving carving(image.view(), testSettings());
+    carving.carve(-1);
+    CHECK(carving.getCarvedWidth() == 30);
+    CHECK(carving.getRemovedSeamCount() == 0);
+    carving.carve(100);
+    CHECK(carving.getCarvedWidth() == 1);
+    CHECK(carving.getRemovedSeamCount() == 29);
+    carving.carve(1);
+    CHECK(carving.getCarvedWidth() == 1);
+
+    SeamCarving empty("/nonexistent/image.png", testSettings());
+    empty.carve(5);
+    CHECK(empty.getRemovedSeamCount() == 0);
+}
+
+int main() {
+    testEmptyImage();
+    testSeamCountClamped();
+    testPixelFormats();
+    testCarveToWidths();
+    return testResult("carving");
+}
@@ -0,0 +1,74 @@
+// Energy kept up to date by the seam removals: around each removed seam only the pixels within
+// the radius of the metric are recomputed, the result must be the energy of the carved image
+
+#include <cstring>
+
+#include "mappedFile.h"
+#include "rawImage.h"
+#include "testUtils.h"
+
+using namespace std;
+
+// Energy of the image, row by row, read back from a .scraw file
+static vector<double> savedEnergy(const SeamCarving& carving, const string& name) {
+    TemporaryPath raw(name);
+    vector<double> energy;
+    MappedFile file;
+    RawImageHeader header;
+    if (!carving.saveRawImageToFile(raw.path, true, false) || !file.open(raw.path, MappedFile::Mode::Read) ||
+        !readRawImageHeader(file, header) || header.energyOffset == 0) {
+        return energy;
+    }
+    for (uint32_t y = 0; y < header.height; ++y) {
+        const double* row = reinterpret_cast<const double*>(file.data() + header.energyOffset) +
+                            static_cast<size_t>(y) * header.stride;
+        energy.insert(energy.end(), row, row + header.width);
+    }
+    return energy;
+}
+
+static bool updatedEnergyIsFresh(const Settings& settings) {
+    SyntheticImage image(90, 40);
+    SeamCarving carving(image.view(), settings);
+    carving.carve(25);
+    CarvedImage carved = carving.snapshot();
+    ImageView view{carved.rgba.data(), carved.width, carved.height, static_cast<size_t>(carved.width) * 4,
+                   PixelFormat::RGBA};
+    SeamCarving fresh(view, settings);
+    vector<double> expected = savedEnergy(fresh, "fresh.scraw");
+    return !expected.empty() && savedEnergy(carving, "carved.scraw") == expected;
+}
+
+static void testEveryMetric() {
+    for (EnergyMetric metric : {EnergyMetric::L2, EnergyMetric::L2Squared, EnergyMetric::L1, EnergyMetric::Luminance,
+                                EnergyMetric::Sobel, EnergyMetric::Scharr, EnergyMetric::Entropy,
+                                EnergyMetric::HogWeighted}) {
+        for (int threads : {1, 2}) {
+            Settings settings = testSettings();
+            settings.energyMetric = metric;
+            settings.seamThreads = threads;
+            if (!updatedEnergyIsFresh(settings)) {
+                fprintf(stderr, "metric %d on %d threads\n", static_cast<int>(metric), threads);
+                CHECK(false);
+            }
+        }
+    }
+}
+
+// Layouts other than the interleaved pixels update their own copies of the pixels
+static void testLayouts() {
+    Settings settings = testSettings();
+    settings.planarLayout = true;
+    CHECK(updatedEnergyIsFresh(settings));
+
+    settings = testSettings();
+    settings.energyMetric = EnergyMetric::Luminance;
+    settings.luminancePlane = true;
+    CHECK(updatedEnergyIsFresh(settings));
+}
+
+int main() {
+    testEveryMetric();
+    testLayouts();
+    return testResult("energy");
+}
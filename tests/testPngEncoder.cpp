@@ -0,0 +1,67 @@
+// PNG encoder: decoded back with stb_image
+
+#include <cstring>
+
+#include "mappedFile.h"
+#include "pngEncoder.h"
+#include "testUtils.h"
+
+#include "../libs/stb_image.h"
+
+using namespace std;
+
+// The encoded image decodes to the rows of `pixels`, `stride` bytes apart
+static bool decodesTo(const vector<unsigned char>& png, const unsigned char* pixels, int width, int height, size_t stride) {
+    int decoded_width = 0, decoded_height = 0, channels = 0;
+    unsigned char* decoded = stbi_load_from_memory(png.data(), static_cast<int>(png.size()), &decoded_width,
+                                                   &decoded_height, &channels, 4);
+    bool same = decoded && decoded_width == width && decoded_height == height;
+    for (int y = 0; same && y < height; ++y) {
+        same = memcmp(decoded + static_cast<size_t>(y) * width * 4, pixels + y * stride, static_cast<size_t>(width) * 4) == 0;
+    }
+    stbi_image_free(decoded);
+    return same;
+}
+
+static void testLevels() {
+    SyntheticImage image(97, 61);
+    for (int level : {0, 1, 6, 9}) {
+        for (bool parallel : {false, true}) {
+            PngOptions options;
+            options.level = level;
+            options.parallel = parallel;
+            vector<unsigned char> png = encodePng(image.rgba.data(), image.width, image.height, 4, image.width * 4, options);
+            CHECK(decodesTo(png, image.rgba.data(), image.width, image.height, image.width * 4));
+        }
+    }
+}
+
+// Rows further apart than 2 GiB, in a sparse temporary file: only the pages of the rows are written
+static void testHugeStride() {
+    const int width = 16;
+    const int height = 3;
+    const size_t stride = size_t(3) << 29;
+    MappedFile file;
+    if (!file.createTemporary(temporaryDirectory(), (height - 1) * stride + width * 4)) {
+        fprintf(stderr, "no temporary file, huge stride not tested\n");
+        return;
+    }
+    for (int y = 0; y < height; ++y) {
+        syntheticRow(y, width, file.data() + y * stride);
+    }
+    for (int level : {0, 6}) {
+        for (bool parallel : {false, true}) {
+            PngOptions options;
+            options.level = level;
+            options.parallel = parallel;
+            vector<unsigned char> png = encodePng(file.data(), width, height, 4, stride, options);
+            CHECK(decodesTo(png, file.data(), width, height, stride));
+        }
+    }
+}
+
+int main() {
+    testLevels();
+    testHugeStride();
+    return testResult("png encoder");
+}
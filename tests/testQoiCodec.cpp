@@ -0,0 +1,114 @@
+// QOI files: every operation of the stream written and read back, row by row or whole
+
+#include <cstring>
+#include <map>
+
+#include "qoiCodec.h"
+#include "testUtils.h"
+
+using namespace std;
+
+static vector<unsigned char> readFile(const string& path) {
+    vector<unsigned char> bytes;
+    if (FILE* file = fopen(path.c_str(), "rb")) {
+        unsigned char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        fclose(file);
+    }
+    return bytes;
+}
+
+// Operations of the stream by tag (the 2-bit ones by their top bits), and the longest run
+static map<int, int> countOps(const vector<unsigned char>& qoi, int& longest_run) {
+    map<int, int> ops;
+    longest_run = 0;
+    const size_t header = 14;
+    const size_t end = 8;
+    for (size_t i = header; i + end < qoi.size();) {
+        unsigned char byte = qoi[i];
+        int op = byte >= 0xfe ? byte : byte & 0xc0;
+        ++ops[op];
+        if (op == 0xc0) {
+            longest_run = max(longest_run, (byte & 0x3f) + 1);
+        }
+        i += op == 0xff ? 5 : op == 0xfe ? 4 : op == 0x80 ? 2 : 1;
+    }
+    return ops;
+}
+
+static void setPixel(vector<unsigned char>& rgba, int width, int x, int y, int r, int g, int b, int a) {
+    unsigned char* p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+    p[0] = static_cast<unsigned char>(r);
+    p[1] = static_cast<unsigned char>(g);
+    p[2] = static_cast<unsigned char>(b);
+    p[3] = static_cast<unsigned char>(a);
+}
+
+// Rows made for each operation: a run over three rows, longer than the longest run op, small and
+// larger steps, alpha changes, then colours seen before
+static void testOperations() {
+    const int width = 40;
+    const int height = 7;
+    vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+    for (int x = 0; x < width; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            setPixel(rgba, width, x, y, 10, 20, 30, 255);
+        }
+        setPixel(rgba, width, x, 3, 10 + x, 20, 30, 255);
+        setPixel(rgba, width, x, 4, 50 + 10 * x, 20 + 10 * x, 31 + 10 * x, 255);
+        setPixel(rgba, width, x, 5, 1, 2, 3, 255 - 5 * x);
+        setPixel(rgba, width, x, 6, x & 1 ? 10 : 49, 20, 30, 255);
+    }
+
+    TemporaryPath path("operations.qoi");
+    QoiWriter writer;
+    CHECK(writer.open(path.path, width, height));
+    for (int y = 0; y < height; ++y) {
+        CHECK(writer.writeRow(&rgba[static_cast<size_t>(y) * width * 4]));
+    }
+    CHECK(writer.close());
+
+    int longest_run = 0;
+    map<int, int> ops = countOps(readFile(path.path), longest_run);
+    CHECK(ops[0x00] > 0);  // index
+    CHECK(ops[0x40] > 0);  // diff
+    CHECK(ops[0x80] > 0);  // luma
+    CHECK(ops[0xc0] > 1);  // runs, the first one split
+    CHECK(ops[0xfe] > 0);  // rgb
+    CHECK(ops[0xff] > 0);  // rgba
+    CHECK(longest_run == 62);
+
+    QoiReader reader;
+    CHECK(reader.open(path.path));
+    CHECK(reader.width() == width && reader.height() == height);
+    vector<unsigned char> row(static_cast<size_t>(width) * 4);
+    for (int y = 0; y < height; ++y) {
+        CHECK(reader.readRow(row.data()));
+        CHECK(memcmp(row.data(), &rgba[static_cast<size_t>(y) * width * 4], row.size()) == 0);
+    }
+}
+
+// A whole image from padded rows, loaded back by SeamCarving
+static void testWholeImage() {
+    SyntheticImage image(123, 45);
+    const size_t stride = image.width * 4 + 12;
+    vector<unsigned char> padded(stride * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        memcpy(&padded[y * stride], &image.rgba[static_cast<size_t>(y) * image.width * 4], image.width * 4);
+    }
+    TemporaryPath path("whole.qoi");
+    CHECK(writeQoi(path.path, padded.data(), image.width, image.height, stride));
+    int width = 0, height = 0;
+    CHECK(readQoiSize(path.path, width, height));
+    CHECK(width == image.width && height == image.height);
+    CHECK(SeamCarving(path.path, testSettings()).snapshot().rgba == image.rgba);
+}
+
+int main() {
+    testOperations();
+    testWholeImage();
+    return testResult("qoi codec");
+}
@@ -0,0 +1,122 @@
+// .scraw files: round trips, carving straight from the mapping and malformed headers
+
+#include <cstring>
+
+#include "mappedFile.h"
+#include "rawImage.h"
+#include "testUtils.h"
+
+using namespace std;
+
+static CarvedImage carvedCopy(const string& path) {
+    SeamCarving carving(path, testSettings());
+    return carving.snapshot();
+}
+
+static bool sameImage(const CarvedImage& a, const CarvedImage& b) {
+    return a.width == b.width && a.height == b.height && a.rgba == b.rgba;
+}
+
+// Saving over the file an image is carved from (in place, through a private mapping) replaces
+// the file without touching the image
+static void testSaveOverMappedSource() {
+    TemporaryPath raw("source.scraw");
+    SyntheticImage image(64, 40);
+    {
+        SeamCarving carving(image.view(), testSettings());
+        carving.carve(4);
+        CHECK(carving.saveRawImageToFile(raw.path, true, false));
+    }
+
+    SeamCarving carving(raw.path, testSettings());
+    CHECK(carving.getCarvedWidth() == 60);
+    carving.carve(5);
+    CarvedImage before = carving.snapshot();
+    CHECK(carving.saveRawImageToFile(raw.path, true, true));
+    CHECK(sameImage(carving.snapshot(), before));
+    CHECK(sameImage(carvedCopy(raw.path), before));
+
+    // Carving goes on from the old mapping
+    carving.carve(5);
+    CHECK(carving.getCarvedWidth() == 50);
+    CHECK(carving.saveRawImageToFile(raw.path, false, false));
+    CHECK(sameImage(carvedCopy(raw.path), carving.snapshot()));
+}
+
+static RawImageHeader rawHeader(uint32_t width, uint32_t height, uint32_t stride) {
+    RawImageHeader header = {};
+    memcpy(header.magic, rawImageMagic, sizeof(rawImageMagic));
+    header.version = rawImageVersion;
+    header.headerSize = sizeof(RawImageHeader);
+    header.width = width;
+    header.height = height;
+    header.stride = stride;
+    header.padding = PixelBuffer::border;
+    header.pixelOffset = rawImageAlignment;
+    return header;
+}
+
+// A file of `size` bytes starting with `header`, sparse past its first page
+static bool writeRawFile(const string& path, const RawImageHeader& header, size_t size) {
+    MappedFile file;
+    if (!file.create(path, size)) {
+        return false;
+    }
+    memcpy(file.data(), &header, sizeof(header));
+    return file.close();
+}
+
+static bool headerAccepted(const string& path) {
+    MappedFile file;
+    RawImageHeader header;
+    return file.open(path, MappedFile::Mode::Read) && readRawImageHeader(file, header);
+}
+
+// Sections whose end does not fit in 64 bits are rejected rather than wrapped around
+static void testOverflowingHeader() {
+    TemporaryPath raw("overflow.scraw");
+    const size_t size = 4096;
+
+    RawImageHeader header = rawHeader(1, 0x7fffffff, 0x7fffffff);
+    header.pixelOffset = uint64_t(1) << 33;
+    CHECK(writeRawFile(raw.path, header, size));
+    CHECK(!headerAccepted(raw.path));
+
+    header = rawHeader(1, 1, 16);
+    CHECK(writeRawFile(raw.path, header, size));
+    CHECK(headerAccepted(raw.path));
+    header.energyOffset = UINT64_MAX - 64;
+    CHECK(writeRawFile(raw.path, header, size));
+    CHECK(!headerAccepted(raw.path));
+    header.energyOffset = 0;
+    header.seamMapWidth = 1;
+    header.seamMapOffset = UINT64_MAX - 2;
+    CHECK(writeRawFile(raw.path, header, size));
+    CHECK(!headerAccepted(raw.path));
+}
+
+// An image wider than maxImageSize, carved in place from its mapping, is not loaded. Its single
+// row takes 8 GiB of a sparse file; systems that refuse to map that much privately do not load it
+// either.
+static void testWiderThanMaxImageSize() {
+    TemporaryPath raw("wide.scraw");
+    const uint32_t width = static_cast<uint32_t>(maxImageSize) + 1;
+    const uint32_t pixels_per_line = rawImageAlignment / 4;
+    const uint32_t stride = (width + 2 * PixelBuffer::border + pixels_per_line - 1) / pixels_per_line * pixels_per_line;
+    RawImageHeader header = rawHeader(width, 1, stride);
+    if (!writeRawFile(raw.path, header, header.pixelOffset + static_cast<size_t>(stride) * 4)) {
+        fprintf(stderr, "no sparse file, image wider than maxImageSize not tested\n");
+        return;
+    }
+    CHECK(headerAccepted(raw.path));
+    SeamCarving carving(raw.path, testSettings());
+    CHECK(carving.getCarvedWidth() == 0);
+    CHECK(carving.getCarvedHeight() == 0);
+}
+
+int main() {
+    testSaveOverMappedSource();
+    testOverflowingHeader();
+    testWiderThanMaxImageSize();
+    return testResult("raw image");
+}
@@ -0,0 +1,38 @@
+// Scheduler and task groups: what a task holds is released before wait() returns
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "scheduler.h"
+#include "testUtils.h"
+
+using namespace std;
+
+// The task copies a shared_ptr whose deleter is slow. A worker runs the task while the waiter is
+// away, so the deleter runs on the worker and wait() has to wait for it too.
+static void testCapturesReleasedBeforeWait() {
+    Scheduler scheduler(2);
+    static atomic<int> released(0);
+    for (int round = 0; round < 5; ++round) {
+        released = 0;
+        {
+            TaskGroup group(scheduler);
+            shared_ptr<void> held(nullptr, [](void*) {
+                this_thread::sleep_for(chrono::milliseconds(30));
+                ++released;
+            });
+            group.run([held] {});
+            held.reset();
+            this_thread::sleep_for(chrono::milliseconds(10));
+            group.wait();
+            CHECK(released == 1);
+        }
+    }
+}
+
+int main() {
+    testCapturesReleasedBeforeWait();
+    return testResult("scheduler");
+}
@@ -0,0 +1,147 @@
+// Seam searches of the engine: every cost type and search plan finds the same seams
+
+#include "testUtils.h"
+
+using namespace std;
+
+static vector<int32_t> carveSeams(const ImageView& view, const Settings& settings, int num_seams) {
+    SeamCarving carving(view, settings);
+    carving.carve(num_seams);
+    return removedSeams(carving);
+}
+
+// The float and fixed-point costs find the seams of the double ones. Float sums of a taller image
+// could round two nearly equal seams the other way; over 120 rows they do not.
+static void testCostTypesMatchDouble() {
+    SyntheticImage image(200, 120);
+    for (EnergyMetric metric : {EnergyMetric::L2, EnergyMetric::L2Squared, EnergyMetric::L1, EnergyMetric::Luminance}) {
+        for (bool backward : {true, false}) {
+            Settings settings = testSettings();
+            settings.energyMetric = metric;
+            settings.doBackwardSearch = backward;
+            vector<int32_t> expected = carveSeams(image.view(), settings, 30);
+            settings.costType = CostType::Float;
+            CHECK(carveSeams(image.view(), settings, 30) == expected);
+            settings.costType = CostType::Fixed;
+            CHECK(carveSeams(image.view(), settings, 30) == expected);
+        }
+    }
+}
+
+// Seams of tall images cost more than the fixed-point maximum at a scale of 1: the scale goes
+// below 1 instead of letting every cost saturate. A checkerboard of 2x2 squares gives every
+// pixel a large energy, but a band of columns of lower contrast is cheaper and the seam follows.
+static void testTallFixedDoesNotSaturate() {
+    const int width = 24;
+    const int height = 30000;
+    const int band_begin = 10;
+    const int band_end = 16;
+    vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            bool in_band = x >= band_begin && x < band_end;
+            unsigned char low = in_band ? 43 : 0;
+            unsigned char high = in_band ? 213 : 255;
+            unsigned char* p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+            p[0] = p[1] = p[2] = ((x >> 1) ^ (y >> 1)) & 1 ? high : low;
+            p[3] = 255;
+        }
+    }
+    ImageView view{rgba.data(), width, height, static_cast<size_t>(width) * 4, PixelFormat::RGBA};
+
+    Settings settings = testSettings();
+    settings.energyMetric = EnergyMetric::L2Squared;
+    vector<int32_t> expected = carveSeams(view, settings, 1);
+    CHECK(expected[height - 1] >= band_begin && expected[height - 1] < band_end);
+    settings.costType = CostType::Fixed;
+    CHECK(carveSeams(view, settings, 1) == expected);
+}
+
+// Out of core, the back-pointers of a table over the budget go to a temporary file, and keep going
+// there once the carved image would fit: the seams are those of a search without any budget
+static void testSpilledBackPointers() {
+    SyntheticImage image(300, 200);
+    for (int threads : {1, 2}) {
+        Settings reference_settings = testSettings();
+        reference_settings.seamThreads = threads;
+        Settings settings = reference_settings;
+        settings.outOfCore = true;
+        settings.spillDirectory = temporaryDirectory();
+        // The 300x200 table is over it, from about 270 pixels wide it fits
+        settings.dpMemoryBudget = 58000;
+        vector<int32_t> expected = carveSeams(image.view(), reference_settings, 120);
+        CHECK(carveSeams(image.view(), settings, 120) == expected);
+
+        // Several carves, each planning its own search
+        SeamCarving carving(image.view(), settings);
+        carving.carveToWidths({250, 200}, [](int, const SeamCarving&) {});
+        carving.carve(20);
+        CHECK(removedSeams(carving) == expected);
+    }
+}
+
+// The tiled search finds the seams of the serial one, for bands of rows shorter than the image
+// or cut by its bottom, and for images too narrow to be tiled
+static void testTiledMatchesSerial() {
+    for (int width : {14, 200}) {
+        for (int height : {1, 3, 75}) {
+            SyntheticImage image(width, height);
+            for (bool backward : {true, false}) {
+                Settings settings = testSettings();
+                settings.doBackwardSearch = backward;
+                vector<int32_t> expected = carveSeams(image.view(), settings, width / 2);
+                for (int threads : {2, 4}) {
+                    settings.seamThreads = threads;
+                    CHECK(carveSeams(image.view(), settings, width / 2) == expected);
+                }
+            }
+        }
+    }
+}
+
+// The checkpointed search, used when the full table is over the budget, finds the seams of the
+// full table. 120 rows are not a multiple of the checkpoint step of 11.
+static void testCheckpointedMatchesFullTable() {
+    SyntheticImage image(200, 120);
+    for (bool backward : {true, false}) {
+        Settings settings = testSettings();
+        settings.doBackwardSearch = backward;
+        vector<int32_t> expected = carveSeams(image.view(), settings, 30);
+        settings.dpMemoryBudget = 1;
+        CHECK(carveSeams(image.view(), settings, 30) == expected);
+    }
+}
+
+// Carving with a luminance plane removes the seams and keeps the pixels of the Luminance metric
+// read from the pixels, alpha counted in the energy or not
+static void testLuminancePlane() {
+    SyntheticImage image(150, 80);
+    for (size_t i = 0; i < image.rgba.size(); i += 4) {
+        image.rgba[i + 3] = static_cast<unsigned char>(255 - (i / 4 * 37) % 97);
+    }
+    for (bool alpha : {false, true}) {
+        for (bool backward : {true, false}) {
+            Settings settings = testSettings();
+            settings.energyMetric = EnergyMetric::Luminance;
+            settings.alphaInEnergy = alpha;
+            settings.doBackwardSearch = backward;
+            SeamCarving expected(image.view(), settings);
+            expected.carve(40);
+            settings.luminancePlane = true;
+            SeamCarving carving(image.view(), settings);
+            carving.carve(40);
+            CHECK(removedSeams(carving) == removedSeams(expected));
+            CHECK(carving.snapshot().rgba == expected.snapshot().rgba);
+        }
+    }
+}
+
+int main() {
+    testCostTypesMatchDouble();
+    testLuminancePlane();
+    testCheckpointedMatchesFullTable();
+    testTiledMatchesSerial();
+    testTallFixedDoesNotSaturate();
+    testSpilledBackPointers();
+    return testResult("seam search");
+}
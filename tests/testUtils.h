@@ -0,0 +1,104 @@
+#ifndef TESTUTILS_H
+#define TESTUTILS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "seamCarving.h"
+
+// Checks of the tests: a failed one is reported and the test exits with 1 once done
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++testFailures(); \
+        } \
+    } while (0)
+
+inline int testResult(const char* name) {
+    if (testFailures() > 0) {
+        fprintf(stderr, "%s: %d checks failed\n", name, testFailures());
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+// Settings with every field set, backward L2 search in doubles
+inline Settings testSettings() {
+    Settings settings;
+    settings.doBackwardSearch = true;
+    settings.showEnergy = false;
+    settings.seamsToRemove = 0;
+    return settings;
+}
+
+// Pixel (x, y) of a deterministic test image: diagonal bands with sharp edges, gradients and a
+// little noise, so that the seams are neither trivial nor ties. Any size can be generated row by row.
+inline Pixel syntheticPixel(int x, int y, uint32_t seed = 1) {
+    uint32_t n = static_cast<uint32_t>(x) * 0x9e3779b1u ^ static_cast<uint32_t>(y) * 0x85ebca77u ^ seed * 0xc2b2ae3du;
+    n ^= n >> 15;
+    n *= 0x2c1b3c6du;
+    n ^= n >> 12;
+    int band = ((x / 37 + y / 23) & 1) * 96;
+    return Pixel{static_cast<unsigned char>(band + (x & 63) + (n & 15)),
+                 static_cast<unsigned char>(((y * 3) & 127) + ((n >> 8) & 15)),
+                 static_cast<unsigned char>(band / 2 + ((x + y) & 63) + ((n >> 16) & 15)), 255};
+}
+
+inline void syntheticRow(int y, int width, unsigned char* rgba, uint32_t seed = 1) {
+    for (int x = 0; x < width; ++x, rgba += 4) {
+        Pixel p = syntheticPixel(x, y, seed);
+        rgba[0] = p.r;
+        rgba[1] = p.g;
+        rgba[2] = p.b;
+        rgba[3] = p.a;
+    }
+}
+
+// Packed RGBA test image and a view of it
+struct SyntheticImage {
+    int width;
+    int height;
+    std::vector<unsigned char> rgba;
+
+    SyntheticImage(int w, int h, uint32_t seed = 1) : width(w), height(h), rgba(static_cast<size_t>(w) * h * 4) {
+        for (int y = 0; y < h; ++y) {
+            syntheticRow(y, w, &rgba[static_cast<size_t>(y) * w * 4], seed);
+        }
+    }
+
+    ImageView view() const {
+        return ImageView{rgba.data(), width, height, static_cast<size_t>(width) * 4, PixelFormat::RGBA};
+    }
+};
+
+// Seams removed by a carving, all of them in removal order
+inline std::vector<int32_t> removedSeams(const SeamCarving& carving) {
+    SeamSpan seams = carving.getLastSeams(carving.getRemovedSeamCount());
+    return std::vector<int32_t>(seams.data, seams.data + static_cast<size_t>(seams.count) * seams.height);
+}
+
+// TMPDIR, or /tmp
+inline std::string temporaryDirectory() {
+    const char* tmpdir = getenv("TMPDIR");
+    return tmpdir && *tmpdir ? tmpdir : "/tmp";
+}
+
+// Temporary file name in temporaryDirectory(), removed by the destructor
+struct TemporaryPath {
+    std::string path;
+
+    explicit TemporaryPath(const std::string& name) : path(temporaryDirectory() + "/seamcarving_test_" + name) {}
+    ~TemporaryPath() { remove(path.c_str()); }
+};
+
+#endif // TESTUTILS_H